@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "codec.hpp"
+
+/**
+ * Data structure that behaves like a chunked_vector,
+ * but stores each state serialized into a contiguous
+ * byte arena per chunk, with an index of where each
+ * state starts.
+ *
+ * Variable-length states then cost no heap allocation
+ * each, and expanding a layer is a sequential scan
+ * over the arenas, handing neighbors a view of the
+ * encoded bytes instead of a decoded state.
+ *
+ * Each chunk can be written to by a single thread.
+ *
+ * @tparam T     the type of the states
+ * @tparam Codec how states are encoded, and viewed
+ *               through Codec::view_type
+ */
+template<class T, class Codec = trivial_codec<T>>
+class arena_layer {
+ public:
+
+  using view_type = typename Codec::view_type;
+
+  /**
+   * The byte arena of a single chunk.
+   */
+  class alignas(64) arena {
+    friend class arena_layer;
+
+   public:
+
+    explicit arena(const Codec &codec) :
+      codec_(codec),
+      offsets_(1, 0) {}
+
+    void push_back(const T &value) {
+      codec_.encode(value, bytes_);
+      offsets_.push_back(bytes_.size());
+    }
+
+    size_t size() const {
+      return offsets_.size() - 1;
+    }
+
+    /**
+     * @param index the index of a state in the arena
+     * @return      a view of the encoded state
+     */
+    view_type operator[](size_t index) const {
+      return codec_.view(bytes_.data() + offsets_[index],
+                         offsets_[index + 1] - offsets_[index]);
+    }
+
+    /**
+     * Remove all states, keeping the memory.
+     */
+    void clear() {
+      bytes_.clear();
+      offsets_.resize(1);
+    }
+
+   private:
+
+    Codec codec_;
+    std::vector<char> bytes_;
+
+    /**
+     * offsets_[i] is where state i starts in bytes_,
+     * and offsets_.back() is the end of the last state.
+     */
+    std::vector<size_t> offsets_;
+  };
+
+  /**
+   * Constructs the layer.
+   *
+   * @param chunk_cnt the number of chunks to create
+   * @param codec     how to encode the states
+   */
+  arena_layer(size_t chunk_cnt, const Codec &codec = Codec()) :
+    chunks_(chunk_cnt, arena(codec)) {}
+
+  /**
+   * Find the number of elements.
+   *
+   * Thread safe due to not mutating anything.
+   *
+   * @return the number of states in all chunks
+   */
+  size_t size() const {
+    size_t res = 0;
+    for (const auto &chunk : chunks_)
+      res += chunk.size();
+    return res;
+  }
+
+  /**
+   * Remove all states, keeping the memory.
+   *
+   * Not thread safe.
+   */
+  void clear() {
+    for (auto &chunk : chunks_)
+      chunk.clear();
+  }
+
+  /**
+   * Access a chunk.
+   *
+   * Modifying the chunk is thread safe
+   * as long as any single chunk_index
+   * is used by at most 1 thread.
+   *
+   * @param chunk_index the index of the chunk to access
+   * @return            a reference to the chunk
+   */
+  arena &chunk(size_t chunk_index) {
+    return chunks_[chunk_index];
+  }
+
+  /**
+   * Call f with a view of every state with a position
+   * in [begin, end), as if the layer was not chunked.
+   *
+   * Thread safe due to not mutating anything.
+   *
+   * @param begin the position of the first state
+   * @param end   the position past the last state
+   * @param f     the function to call with every view
+   */
+  template<class F>
+  void for_each(size_t begin, size_t end, F &&f) const {
+    size_t chunk_begin = 0;
+    for (const auto &chunk : chunks_) {
+      size_t chunk_end = chunk_begin + chunk.size();
+      for (size_t i = std::max(begin, chunk_begin); i < std::min(end, chunk_end); ++i)
+        f(chunk[i - chunk_begin]);
+      chunk_begin = chunk_end;
+    }
+  }
+
+ private:
+
+  std::vector<arena> chunks_;
+
+};
@@ -1,91 +1,1697 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "arena_layer.hpp"
 #include "chunked_vector.hpp"
+#include "compressed_layer.hpp"
+#include "cuckoo_filter.hpp"
+#include "depth_map.hpp"
 #include "fixed_size_set.hpp"
+#include "mmap_set.hpp"
+#include "parallel_hashmap/btree.h"
 #include "parallel_hashmap/phmap.h"
+#include "parent_layers.hpp"
+#include "rank_bitmap.hpp"
+#include "reorder.hpp"
+#include "shm_set.hpp"
+#include "spilled_layer.hpp"
+#include "splitmix64.hpp"
+#include "symmetry.hpp"
 
+/**
+ * Layer callback that does nothing, for
+ * when no one is interested in the layers.
+ */
+struct ignore_layer {
+  template <class Layer>
+  void operator()(Layer &&, std::size_t) const {}
+};
+
+/**
+ * Only the layer being expanded and the layer being
+ * filled are kept in memory. Every layer is passed to
+ * on_layer(layer, depth) when it is complete and before
+ * it is expanded, and its memory is then reused for
+ * the layer after the next.
+ */
 template <class Neighbors, class T, class Hash = std::hash<T>,
-          class KeyEqual = std::equal_to<T>>
-bool sequential_bfs(Neighbors &&neighbors, const T &initial_state) {
-  std::vector<std::vector<T>> layers;
-  layers.emplace_back();
-  layers.back().push_back(initial_state);
+          class KeyEqual = std::equal_to<T>, class OnLayer = ignore_layer>
+bool sequential_bfs(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                    OnLayer &&on_layer = OnLayer()) {
+  std::vector<T> layer, next_layer;
 
   phmap::parallel_flat_hash_set<T, Hash, KeyEqual> vis;
-  vis.emplace(initial_state);
+  for (auto &state : initial_states)
+    if (vis.emplace(state).second) layer.push_back(state);
 
   auto step = [&]() {
-    for (auto &node : layers.end()[-2])
+    for (auto &node : layer)
       for (auto next : neighbors(node))
-        if (vis.emplace(next).second) layers.back().push_back(next);
+        if (vis.emplace(next).second) next_layer.push_back(next);
   };
 
-  std::size_t q_size = layers.back().size();
-  while ((q_size = layers.back().size())) {
-    layers.emplace_back();
+  std::size_t depth = 0;
+  while (layer.size()) {
+    on_layer(layer, depth++);
     step();
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>, class OnLayer = ignore_layer>
+bool sequential_bfs(Neighbors &&neighbors, const T &initial_state,
+                    OnLayer &&on_layer = OnLayer()) {
+  return sequential_bfs<Neighbors, T, Hash, KeyEqual, OnLayer>(
+      std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+      std::forward<OnLayer>(on_layer));
+}
+
+/**
+ * Put the initial states that are not yet visited
+ * into layer, spread over its chunks, using a thread
+ * per chunk when there are many initial states.
+ */
+template <class Layer, class VisSet, class T>
+void seed_layer(Layer &layer, VisSet &vis, const std::vector<T> &initial_states,
+                int thread_count) {
+  constexpr std::size_t min_parallel_size = 1 << 12;
+
+  auto seed = [&](int thread_id) {
+    auto &chunk = layer.chunk(thread_id);
+    std::size_t n = initial_states.size();
+    for (std::size_t i = n * thread_id / thread_count;
+         i < n * (thread_id + 1) / thread_count; ++i)
+      if (vis.emplace(initial_states[i]).second)
+        chunk.push_back(initial_states[i]);
+  };
+
+  if (initial_states.size() < min_parallel_size) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      seed(thread_id);
+    return;
+  }
+
+  std::vector<std::thread> threads(thread_count);
+  for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+    threads[thread_id] = std::thread(seed, thread_id);
+  for (auto &thread : threads) thread.join();
+}
+
+/**
+ * Only the layer being expanded and the layer being
+ * filled are kept in memory. Every layer is passed to
+ * on_layer(layer, depth) when it is complete and before
+ * it is expanded, so it may be reordered or copied
+ * out, and its chunks are then cleared and reused
+ * for the layer after the next.
+ *
+ * Layer 0 holds every distinct state of initial_states,
+ * or just initial_state for the single source overload.
+ */
+template <class Neighbors, class T, class VisSet,
+          class OnLayer = ignore_layer, class Allocator = std::allocator<T>>
+bool bfs(Neighbors &&neighbors, const std::vector<T> &initial_states,
+         int thread_count, VisSet &&vis, OnLayer &&on_layer = OnLayer(),
+         const Allocator &alloc = Allocator()) {
+  chunked_vector<T, Allocator> layer(thread_count, alloc);
+  chunked_vector<T, Allocator> next_layer(thread_count, alloc);
+  seed_layer(layer, vis, initial_states, thread_count);
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(layer.split(0)) ranges;
+
+  auto step = [&](int thread_id) {
+    auto &new_queue = next_layer.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    while (begin != end)
+      for (auto next : neighbors(*(begin++)))
+        if (vis.emplace(next).second) new_queue.push_back(next);
+  };
+
+  std::size_t depth = 0;
+  while (layer.size()) {
+    on_layer(layer, depth++);
+
+    ranges = layer.split(thread_count);
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class VisSet,
+          class OnLayer = ignore_layer, class Allocator = std::allocator<T>>
+bool bfs(Neighbors &&neighbors, const T &initial_state, int thread_count,
+         VisSet &&vis, OnLayer &&on_layer = OnLayer(),
+         const Allocator &alloc = Allocator()) {
+  return bfs(std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+             thread_count, std::forward<VisSet>(vis),
+             std::forward<OnLayer>(on_layer), alloc);
+}
+
+/**
+ * Like bfs, but every thread collects batch_size successors
+ * and inserts them with vis.emplace_batch. on_layer(layer,
+ * depth) is called before every layer is expanded, while
+ * no thread touches vis.
+ */
+template <class Neighbors, class T, class VisSet,
+          class OnLayer = ignore_layer>
+bool bfs_batched(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                 int thread_count, VisSet &&vis, std::size_t batch_size,
+                 OnLayer &&on_layer = OnLayer()) {
+  chunked_vector<T> layer(thread_count);
+  chunked_vector<T> next_layer(thread_count);
+  seed_layer(layer, vis, initial_states, thread_count);
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(layer.split(0)) ranges;
+
+  auto step = [&](int thread_id) {
+    auto &new_queue = next_layer.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    std::vector<T> batch;
+    auto flush = [&]() {
+      vis.emplace_batch(batch.begin(), batch.end(),
+                        std::back_inserter(new_queue));
+      batch.clear();
+    };
+    while (begin != end) {
+      for (auto next : neighbors(*(begin++))) batch.push_back(next);
+      if (batch.size() >= batch_size) flush();
+    }
+    flush();
+  };
+
+  std::size_t depth = 0;
+  while (layer.size()) {
+    on_layer(layer, depth++);
+
+    ranges = layer.split(thread_count);
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
   }
 
   return false;
 }
 
+template <class Neighbors, class T, class VisSet,
+          class OnLayer = ignore_layer>
+bool bfs_batched(Neighbors &&neighbors, const T &initial_state, int thread_count,
+                 VisSet &&vis, std::size_t batch_size,
+                 OnLayer &&on_layer = OnLayer()) {
+  return bfs_batched(std::forward<Neighbors>(neighbors),
+                     std::vector<T>{initial_state}, thread_count,
+                     std::forward<VisSet>(vis), batch_size,
+                     std::forward<OnLayer>(on_layer));
+}
+
+/**
+ * Parallel bfs that forgets states once their layer
+ * is more than layer_window layers behind the frontier,
+ * by erasing them from vis. Requires vis.erase(state).
+ *
+ * This is exact when every transition stays within
+ * layer_window layers back, like layer_window = 2 for
+ * undirected transitions, and otherwise old states
+ * may be expanded again.
+ *
+ * With a vis that has false positives, like a filter, a
+ * state can also be dropped and found again in a later
+ * layer once the state shadowing it is forgotten, and
+ * its neighbors are then forgotten too, so the search
+ * can go on forever. No state deeper than max_depth
+ * is reached, so passing a bound on the depth of the
+ * states, like the diameter, ensures that it ends.
+ */
 template <class Neighbors, class T, class VisSet>
-bool bfs(Neighbors &&neighbors, const T &initial_state, int thread_count, VisSet &&vis) {
-  std::vector<chunked_vector<T>> layers;
+bool bfs_windowed(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                  int thread_count, VisSet &&vis, std::size_t layer_window,
+                  std::size_t max_depth = std::numeric_limits<std::size_t>::max()) {
+  std::deque<chunked_vector<T>> layers;
   layers.emplace_back(thread_count);
-  layers.back().chunk(0).push_back(initial_state);
+  seed_layer(layers.back(), vis, initial_states, thread_count);
 
-  vis.emplace(initial_state);
+  // the memory of the last retired layer,
+  // reused for the next layer to be filled
+  chunked_vector<T> spare(thread_count);
 
   std::vector<std::thread> threads(thread_count);
+  decltype(layers.front().split(0)) ranges;
 
-  auto step = [&](int thread_id, std::size_t begin_index,
-                  std::size_t end_index) {
+  auto step = [&](int thread_id) {
     auto &new_queue = layers.back().chunk(thread_id);
-    auto begin = layers.end()[-2].begin() + begin_index;
-    auto end = layers.end()[-2].begin() + end_index;
+    auto [begin, end] = ranges[thread_id];
     while (begin != end)
       for (auto next : neighbors(*(begin++)))
         if (vis.emplace(next).second) new_queue.push_back(next);
   };
 
-  std::size_t q_size = layers.back().size();
-  while ((q_size = layers.back().size())) {
-    layers.emplace_back(thread_count);
+  auto retire = [&](int thread_id) {
+    for (auto &state : layers.front().chunk(thread_id)) vis.erase(state);
+  };
+
+  for (std::size_t depth = 0; layers.back().size() && depth < max_depth; ++depth) {
+    layers.push_back(std::move(spare));
+    spare = chunked_vector<T>(thread_count);
+
+    ranges = layers.end()[-2].split(thread_count);
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    if (layers.size() > layer_window + 1) {
+      for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+        threads[thread_id] = std::thread(retire, thread_id);
+      for (auto &thread : threads) thread.join();
+      spare = std::move(layers.front());
+      spare.clear();
+      layers.pop_front();
+    }
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class VisSet>
+bool bfs_windowed(Neighbors &&neighbors, const T &initial_state,
+                  int thread_count, VisSet &&vis, std::size_t layer_window,
+                  std::size_t max_depth = std::numeric_limits<std::size_t>::max()) {
+  return bfs_windowed(std::forward<Neighbors>(neighbors),
+                      std::vector<T>{initial_state}, thread_count,
+                      std::forward<VisSet>(vis), layer_window, max_depth);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>,
+          class Allocator = phmap::priv::Allocator<T>>
+bool bfs_phmap(Neighbors &&neighbors, const T &initial_state,
+               int thread_count, const Allocator &alloc = Allocator()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, Allocator, 4UL, std::mutex>
+      vis(0, Hash(), KeyEqual(), alloc);
+  return bfs(std::forward<Neighbors>(neighbors), initial_state, thread_count,
+             vis, ignore_layer(), alloc);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>,
+          class Allocator = phmap::priv::Allocator<T>>
+bool bfs_phmap(Neighbors &&neighbors, const std::vector<T> &initial_states,
+               int thread_count, const Allocator &alloc = Allocator()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, Allocator, 4UL, std::mutex>
+      vis(0, Hash(), KeyEqual(), alloc);
+  return bfs(std::forward<Neighbors>(neighbors), initial_states, thread_count,
+             vis, ignore_layer(), alloc);
+}
+
+/**
+ * Like bfs_phmap, but every thread collects batch_size
+ * successors before looking them up, and slot_ordered_set
+ * orders each batch by the slots of the visited set the
+ * states hash to. This pays off once the visited set is
+ * much larger than the cache.
+ */
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_phmap_reordered(Neighbors &&neighbors, const T &initial_state,
+                         int thread_count, std::size_t batch_size = 1 << 20) {
+  using set_type =
+      phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                    4UL, std::mutex>;
+  set_type vis;
+  slot_ordered_set<set_type> ordered(vis);
+  return bfs_batched(std::forward<Neighbors>(neighbors), initial_state,
+                     thread_count, ordered, batch_size,
+                     [&](auto &, std::size_t) { ordered.prepare(); });
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_phmap_reordered(Neighbors &&neighbors,
+                         const std::vector<T> &initial_states, int thread_count,
+                         std::size_t batch_size = 1 << 20) {
+  using set_type =
+      phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                    4UL, std::mutex>;
+  set_type vis;
+  slot_ordered_set<set_type> ordered(vis);
+  return bfs_batched(std::forward<Neighbors>(neighbors), initial_states,
+                     thread_count, ordered, batch_size,
+                     [&](auto &, std::size_t) { ordered.prepare(); });
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>,
+          class Allocator = std::allocator<T>>
+bool bfs_fixed_size_set(Neighbors &&neighbors, const T &initial_state,
+                        int thread_count, int hash_bit_count,
+                        const Allocator &alloc = Allocator()) {
+  fixed_size_set<T, Hash, KeyEqual, Allocator> vis(
+      hash_bit_count, std::chrono::steady_clock::now().time_since_epoch().count(),
+      Hash(), KeyEqual(), alloc);
+  return bfs(std::forward<Neighbors>(neighbors), initial_state, thread_count,
+             vis, ignore_layer(), alloc);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>,
+          class Allocator = std::allocator<T>>
+bool bfs_fixed_size_set(Neighbors &&neighbors,
+                        const std::vector<T> &initial_states, int thread_count,
+                        int hash_bit_count,
+                        const Allocator &alloc = Allocator()) {
+  fixed_size_set<T, Hash, KeyEqual, Allocator> vis(
+      hash_bit_count, std::chrono::steady_clock::now().time_since_epoch().count(),
+      Hash(), KeyEqual(), alloc);
+  return bfs(std::forward<Neighbors>(neighbors), initial_states, thread_count,
+             vis, ignore_layer(), alloc);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_mmap_set(Neighbors &&neighbors, const T &initial_state,
+                  int thread_count, const std::string &directory,
+                  int page_bits, std::size_t batch_size = 4096) {
+  mmap_set<T, Hash, KeyEqual> vis(directory, page_bits);
+  return bfs_batched(std::forward<Neighbors>(neighbors), initial_state,
+                     thread_count, vis, batch_size);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_mmap_set(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                  int thread_count, const std::string &directory,
+                  int page_bits, std::size_t batch_size = 4096) {
+  mmap_set<T, Hash, KeyEqual> vis(directory, page_bits);
+  return bfs_batched(std::forward<Neighbors>(neighbors), initial_states,
+                     thread_count, vis, batch_size);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_shm_set(Neighbors &&neighbors, const T &initial_state,
+                 int thread_count, const std::string &name, int hash_bit_count) {
+  shm_set<T, Hash, KeyEqual> vis(name, hash_bit_count);
+  return bfs(std::forward<Neighbors>(neighbors), initial_state, thread_count, vis);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_shm_set(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                 int thread_count, const std::string &name, int hash_bit_count) {
+  shm_set<T, Hash, KeyEqual> vis(name, hash_bit_count);
+  return bfs(std::forward<Neighbors>(neighbors), initial_states, thread_count,
+             vis);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>>
+bool bfs_cuckoo_filter(Neighbors &&neighbors, const T &initial_state,
+                       int thread_count, int bucket_bit_count,
+                       std::size_t layer_window = 2,
+                       std::size_t max_depth = std::numeric_limits<std::size_t>::max()) {
+  cuckoo_filter<T, Hash> vis(bucket_bit_count);
+  return bfs_windowed(std::forward<Neighbors>(neighbors), initial_state,
+                      thread_count, vis, layer_window, max_depth);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>>
+bool bfs_cuckoo_filter(Neighbors &&neighbors,
+                       const std::vector<T> &initial_states, int thread_count,
+                       int bucket_bit_count, std::size_t layer_window = 2,
+                       std::size_t max_depth = std::numeric_limits<std::size_t>::max()) {
+  cuckoo_filter<T, Hash> vis(bucket_bit_count);
+  return bfs_windowed(std::forward<Neighbors>(neighbors), initial_states,
+                      thread_count, vis, layer_window, max_depth);
+}
+
+/**
+ * Parallel bfs with delayed duplicate detection.
+ *
+ * Successors are collected without any lookups, then each
+ * thread sorts its own candidates, and every thread merges
+ * one key range of the candidates against the same range
+ * of the sorted history in vis. Lookups thereby become
+ * mostly sequential scans, and the layers come out sorted.
+ *
+ * vis is left holding every reached state in order,
+ * so it can be used for range scans afterwards.
+ */
+template <class Neighbors, class T, class Compare = std::less<T>>
+bool bfs_delayed_dedup(Neighbors &&neighbors,
+                       const std::vector<T> &initial_states, int thread_count,
+                       phmap::btree_set<T, Compare> &vis) {
+  Compare less = vis.key_comp();
+
+  chunked_vector<T> layer(thread_count);
+  chunked_vector<T> candidates(thread_count);
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(layer.split(0)) ranges;
+  std::vector<T> splitters;
+
+  auto sort_candidates = [&](segmented_chunk<T> &out) {
+    std::sort(out.begin(), out.end(), less);
+    out.erase(std::unique(out.begin(), out.end(),
+                          [&](const T &l, const T &r) {
+                            return !less(l, r) && !less(r, l);
+                          }),
+              out.end());
+  };
+
+  // the initial states are candidates like any other,
+  // so that they are spread over the threads and
+  // deduplicated by the same merge as every layer
+  auto seed = [&](int thread_id) {
+    auto &out = candidates.chunk(thread_id);
+    std::size_t n = initial_states.size();
+    for (std::size_t i = n * thread_id / thread_count;
+         i < n * (thread_id + 1) / thread_count; ++i)
+      out.push_back(initial_states[i]);
+    sort_candidates(out);
+  };
+
+  auto expand = [&](int thread_id) {
+    auto &out = candidates.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    while (begin != end)
+      for (auto next : neighbors(*(begin++))) out.push_back(next);
+    sort_candidates(out);
+  };
+
+  // merges the candidates in [splitters[id-1], splitters[id])
+  // against vis, and outputs the new ones in sorted order
+  auto merge = [&](int thread_id) {
+    using range = std::pair<typename segmented_chunk<T>::const_iterator,
+                            typename segmented_chunk<T>::const_iterator>;
+    auto greater_front = [&](const range &l, const range &r) {
+      return less(*r.first, *l.first);
+    };
+    std::priority_queue<range, std::vector<range>, decltype(greater_front)>
+        heads(greater_front);
+
+    for (int chunk_id = 0; chunk_id < thread_count; ++chunk_id) {
+      const auto &chunk = candidates.chunk(chunk_id);
+      auto first = thread_id == 0 ? chunk.begin()
+                                  : std::lower_bound(chunk.begin(), chunk.end(),
+                                                     splitters[thread_id - 1], less);
+      auto last = thread_id == thread_count - 1
+                      ? chunk.end()
+                      : std::lower_bound(chunk.begin(), chunk.end(),
+                                         splitters[thread_id], less);
+      if (first != last) heads.emplace(first, last);
+    }
+
+    auto &out = layer.chunk(thread_id);
+    auto history = vis.end();
+    const T *previous = nullptr;
+    while (!heads.empty()) {
+      range head = heads.top();
+      heads.pop();
+      const T &candidate = *head.first;
+      if (++head.first != head.second) heads.push(head);
+
+      if (previous && !less(*previous, candidate)) continue;
+      previous = &candidate;
+
+      // walk the history forward a few steps,
+      // and only search it when the gap is large
+      if (history == vis.end()) history = vis.lower_bound(candidate);
+      for (int walked = 0; history != vis.end() && less(*history, candidate);
+           ++walked, ++history)
+        if (walked == 8) {
+          history = vis.lower_bound(candidate);
+          break;
+        }
+
+      if (history == vis.end() || less(candidate, *history))
+        out.push_back(candidate);
+    }
+  };
+
+  auto run = [&](auto &step) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+    for (auto &thread : threads) thread.join();
+  };
+
+  // turns the candidates into the next layer,
+  // and adds that layer to vis
+  auto settle = [&]() {
+    layer.clear();
+    if (!candidates.size()) return;
+
+    // split the key range evenly by sampling
+    // the sorted candidates of every thread
+    std::vector<T> sample;
+    for (int chunk_id = 0; chunk_id < thread_count; ++chunk_id) {
+      const auto &chunk = candidates.chunk(chunk_id);
+      for (int i = 1; i < thread_count && !chunk.empty(); ++i)
+        sample.push_back(chunk[chunk.size() * i / thread_count]);
+    }
+    std::sort(sample.begin(), sample.end(), less);
+    splitters.clear();
+    for (int i = 1; i < thread_count; ++i)
+      splitters.push_back(sample[sample.size() * i / thread_count]);
+
+    run(merge);
+
+    // the new layer is sorted across its chunks,
+    // so each insertion lands right after the last
+    auto hint = vis.begin();
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      for (const auto &state : layer.chunk(thread_id))
+        hint = std::next(vis.insert(hint, state));
+  };
+
+  run(seed);
+  settle();
+
+  while (layer.size()) {
+    candidates.clear();
+    ranges = layer.split(thread_count);
+    run(expand);
+    settle();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class Compare = std::less<T>>
+bool bfs_delayed_dedup(Neighbors &&neighbors, const T &initial_state,
+                       int thread_count, phmap::btree_set<T, Compare> &vis) {
+  return bfs_delayed_dedup(std::forward<Neighbors>(neighbors),
+                           std::vector<T>{initial_state}, thread_count, vis);
+}
+
+template <class Neighbors, class T, class Compare = std::less<T>>
+bool bfs_delayed_dedup(Neighbors &&neighbors,
+                       const std::vector<T> &initial_states, int thread_count) {
+  phmap::btree_set<T, Compare> vis;
+  return bfs_delayed_dedup(std::forward<Neighbors>(neighbors), initial_states,
+                           thread_count, vis);
+}
+
+template <class Neighbors, class T, class Compare = std::less<T>>
+bool bfs_delayed_dedup(Neighbors &&neighbors, const T &initial_state,
+                       int thread_count) {
+  return bfs_delayed_dedup<Neighbors, T, Compare>(
+      std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+      thread_count);
+}
+
+/**
+ * Parallel bfs that, when transitions are undirected, keeps
+ * no global visited set. Every neighbor of a state in layer d
+ * is then in layer d-1, d or d+1, so it is enough to check
+ * successors against those three layers and forget the rest.
+ * Memory then scales with the widest frontier instead of
+ * with the whole state space.
+ *
+ * With undirected false this is the same as bfs_phmap.
+ */
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_frontier_search(Neighbors &&neighbors,
+                         const std::vector<T> &initial_states,
+                         int thread_count, bool undirected) {
+  if (!undirected)
+    return bfs_phmap<Neighbors, T, Hash, KeyEqual>(
+        std::forward<Neighbors>(neighbors), initial_states, thread_count);
+
+  using layer_set =
+      phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                    4UL, std::mutex>;
+  layer_set previous, current, next;
+
+  chunked_vector<T> layer(thread_count);
+  chunked_vector<T> next_layer(thread_count);
+  seed_layer(layer, current, initial_states, thread_count);
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(layer.split(0)) ranges;
+
+  auto step = [&](int thread_id) {
+    auto &new_queue = next_layer.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    while (begin != end)
+      for (auto next_state : neighbors(*(begin++)))
+        if (!previous.contains(next_state) && !current.contains(next_state)
+            && next.emplace(next_state).second)
+          new_queue.push_back(next_state);
+  };
+
+  while (layer.size()) {
+    ranges = layer.split(thread_count);
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    std::swap(previous, current);
+    std::swap(current, next);
+    next.clear();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_frontier_search(Neighbors &&neighbors, const T &initial_state,
+                         int thread_count, bool undirected) {
+  return bfs_frontier_search<Neighbors, T, Hash, KeyEqual>(
+      std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+      thread_count, undirected);
+}
+
+/**
+ * Parallel bfs that keeps the layers on disk, for when
+ * even the frontier does not fit in RAM. Thread i streams
+ * chunk i of the layer back with read-ahead while writing
+ * its successors to chunk i of the next layer, and the I/O
+ * runs on separate threads so it overlaps with expansion.
+ *
+ * @param directory where to put the layer files, preferably local NVMe
+ * @param codec     how to turn states into bytes and back
+ * @param compress  how to store blocks of encoded states
+ */
+template <class Neighbors, class T, class VisSet,
+          class Codec = trivial_codec<T>,
+          class Compressor = identity_compressor>
+bool bfs_spilled(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                 int thread_count, VisSet &&vis, const std::string &directory,
+                 const Codec &codec = Codec(),
+                 const Compressor &compress = Compressor()) {
+  using layer_type = spilled_layer<T, Codec, Compressor>;
+
+  async_io io(thread_count);
+  std::size_t depth = 0;
+  auto make_layer = [&]() {
+    return std::make_unique<layer_type>(
+        io, directory + "/layer" + std::to_string(depth++), thread_count,
+        codec, compress);
+  };
+
+  auto layer = make_layer();
+  seed_layer(*layer, vis, initial_states, thread_count);
+  layer->seal();
+
+  std::unique_ptr<layer_type> next_layer;
+  std::vector<std::thread> threads(thread_count);
+
+  auto step = [&](int thread_id) {
+    auto &new_queue = next_layer->chunk(thread_id);
+    auto queue = layer->read_chunk(thread_id);
+    T state;
+    while (queue.next(state))
+      for (auto next : neighbors(state))
+        if (vis.emplace(next).second) new_queue.push_back(next);
+    new_queue.flush();
+  };
+
+  while (layer->size()) {
+    next_layer = make_layer();
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    layer = std::move(next_layer);
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class VisSet,
+          class Codec = trivial_codec<T>,
+          class Compressor = identity_compressor>
+bool bfs_spilled(Neighbors &&neighbors, const T &initial_state,
+                 int thread_count, VisSet &&vis, const std::string &directory,
+                 const Codec &codec = Codec(),
+                 const Compressor &compress = Compressor()) {
+  return bfs_spilled(std::forward<Neighbors>(neighbors),
+                     std::vector<T>{initial_state}, thread_count,
+                     std::forward<VisSet>(vis), directory, codec, compress);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>, class Codec = trivial_codec<T>>
+bool bfs_phmap_spilled(Neighbors &&neighbors, const T &initial_state,
+                       int thread_count, const std::string &directory,
+                       const Codec &codec = Codec()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  return bfs_spilled(std::forward<Neighbors>(neighbors), initial_state,
+                     thread_count, vis, directory, codec);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>, class Codec = trivial_codec<T>>
+bool bfs_phmap_spilled(Neighbors &&neighbors,
+                       const std::vector<T> &initial_states, int thread_count,
+                       const std::string &directory,
+                       const Codec &codec = Codec()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  return bfs_spilled(std::forward<Neighbors>(neighbors), initial_states,
+                     thread_count, vis, directory, codec);
+}
 
-    size_t per_thread = (q_size + thread_count - 1) / thread_count;
+/**
+ * Parallel bfs whose layers are arena_layers, so each state
+ * is stored serialized in a per-thread byte arena, and
+ * neighbors is called with a Codec::view_type of the
+ * encoded state rather than with a decoded T.
+ */
+template <class Neighbors, class T, class VisSet,
+          class Codec = trivial_codec<T>>
+bool bfs_arena(Neighbors &&neighbors, const std::vector<T> &initial_states,
+               int thread_count, VisSet &&vis, const Codec &codec = Codec()) {
+  arena_layer<T, Codec> layer(thread_count, codec);
+  arena_layer<T, Codec> next_layer(thread_count, codec);
+  seed_layer(layer, vis, initial_states, thread_count);
 
+  std::vector<std::thread> threads(thread_count);
+  std::size_t q_size;
+
+  auto step = [&](int thread_id) {
+    auto &new_queue = next_layer.chunk(thread_id);
+    layer.for_each(q_size * thread_id / thread_count,
+                   q_size * (thread_id + 1) / thread_count,
+                   [&](const auto &view) {
+                     for (auto next : neighbors(view))
+                       if (vis.emplace(next).second) new_queue.push_back(next);
+                   });
+  };
+
+  while ((q_size = layer.size())) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class VisSet,
+          class Codec = trivial_codec<T>>
+bool bfs_arena(Neighbors &&neighbors, const T &initial_state, int thread_count,
+               VisSet &&vis, const Codec &codec = Codec()) {
+  return bfs_arena(std::forward<Neighbors>(neighbors),
+                   std::vector<T>{initial_state}, thread_count,
+                   std::forward<VisSet>(vis), codec);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>, class Codec = trivial_codec<T>>
+bool bfs_phmap_arena(Neighbors &&neighbors, const T &initial_state,
+                     int thread_count, const Codec &codec = Codec()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  return bfs_arena(std::forward<Neighbors>(neighbors), initial_state,
+                   thread_count, vis, codec);
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>, class Codec = trivial_codec<T>>
+bool bfs_phmap_arena(Neighbors &&neighbors,
+                     const std::vector<T> &initial_states, int thread_count,
+                     const Codec &codec = Codec()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  return bfs_arena(std::forward<Neighbors>(neighbors), initial_states,
+                   thread_count, vis, codec);
+}
+
+/**
+ * Parallel bfs over a state space where states can be
+ * ranked to integers, storing the layers as compressed
+ * sorted ranks instead of states, and the visited set
+ * as a set of ranks.
+ *
+ * @param rank   function mapping a state to its uint64_t rank
+ * @param unrank function mapping a rank back to its state
+ * @param vis    set of uint64_t ranks
+ */
+template <class Neighbors, class T, class Rank, class Unrank, class VisSet>
+bool bfs_compressed(Neighbors &&neighbors,
+                    const std::vector<T> &initial_states, int thread_count,
+                    Rank &&rank, Unrank &&unrank, VisSet &&vis) {
+  compressed_layer layer(thread_count);
+  compressed_layer next_layer(thread_count);
+  std::vector<std::vector<uint64_t>> new_ranks(thread_count);
+
+  for (const auto &state : initial_states) {
+    uint64_t state_rank = rank(state);
+    if (vis.emplace(state_rank).second) new_ranks[0].push_back(state_rank);
+  }
+  layer.compress_chunk(0, new_ranks[0]);
+
+  std::vector<std::thread> threads(thread_count);
+
+  auto step = [&](int thread_id) {
+    auto &out = new_ranks[thread_id];
+    out.clear();
+    layer.for_each(thread_id, thread_count, [&](uint64_t state_rank) {
+      for (const auto &next : neighbors(unrank(state_rank))) {
+        uint64_t next_rank = rank(next);
+        if (vis.emplace(next_rank).second) out.push_back(next_rank);
+      }
+    });
+    next_layer.compress_chunk(thread_id, out);
+  };
+
+  while (layer.size()) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class Rank, class Unrank, class VisSet>
+bool bfs_compressed(Neighbors &&neighbors, const T &initial_state,
+                    int thread_count, Rank &&rank, Unrank &&unrank,
+                    VisSet &&vis) {
+  return bfs_compressed(std::forward<Neighbors>(neighbors),
+                        std::vector<T>{initial_state}, thread_count,
+                        std::forward<Rank>(rank), std::forward<Unrank>(unrank),
+                        std::forward<VisSet>(vis));
+}
+
+template <class Neighbors, class T, class Rank, class Unrank>
+bool bfs_phmap_compressed(Neighbors &&neighbors, const T &initial_state,
+                          int thread_count, Rank &&rank, Unrank &&unrank) {
+  phmap::parallel_flat_hash_set<uint64_t, phmap::Hash<uint64_t>,
+                                phmap::EqualTo<uint64_t>,
+                                phmap::priv::Allocator<uint64_t>, 4UL,
+                                std::mutex>
+      vis;
+  return bfs_compressed(std::forward<Neighbors>(neighbors), initial_state,
+                        thread_count, std::forward<Rank>(rank),
+                        std::forward<Unrank>(unrank), vis);
+}
+
+template <class Neighbors, class T, class Rank, class Unrank>
+bool bfs_phmap_compressed(Neighbors &&neighbors,
+                          const std::vector<T> &initial_states,
+                          int thread_count, Rank &&rank, Unrank &&unrank) {
+  phmap::parallel_flat_hash_set<uint64_t, phmap::Hash<uint64_t>,
+                                phmap::EqualTo<uint64_t>,
+                                phmap::priv::Allocator<uint64_t>, 4UL,
+                                std::mutex>
+      vis;
+  return bfs_compressed(std::forward<Neighbors>(neighbors), initial_states,
+                        thread_count, std::forward<Rank>(rank),
+                        std::forward<Unrank>(unrank), vis);
+}
+
+/**
+ * Parallel bfs over a state space where states can be
+ * ranked to integers below rank_count, storing the
+ * layers and the visited set as rank_bitmaps.
+ *
+ * Threads scan a part of the layer bitmap each, split
+ * so they get about as many states, and atomically
+ * set the bits of successors in the next layer that
+ * are not visited. The next layer is then reduced to
+ * its new states by next &= ~visited over whole words,
+ * which is also when it is counted and merged into
+ * the visited bitmap.
+ *
+ * Memory is 3 bits per rank, so this suits layers
+ * that cover a large part of the rank space.
+ */
+template <class Neighbors, class T, class Rank, class Unrank>
+bool bfs_bitmap(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                int thread_count, Rank &&rank, Unrank &&unrank,
+                uint64_t rank_count) {
+  // layers are counted and split in blocks of this many words
+  constexpr std::size_t block_words = 64;
+
+  rank_bitmap layer(rank_count);
+  rank_bitmap next_layer(rank_count);
+  rank_bitmap vis(rank_count);
+
+  std::size_t word_cnt = layer.word_count();
+  std::size_t block_cnt = (word_cnt + block_words - 1) / block_words;
+  std::vector<uint64_t> block_sizes(block_cnt);
+  std::vector<std::size_t> bounds(thread_count + 1);
+
+  // the initial states go through settle like any later
+  // layer, which drops duplicates and counts the blocks
+  for (const auto &state : initial_states) next_layer.set(rank(state));
+  uint64_t layer_size = 0;
+
+  std::vector<std::thread> threads(thread_count);
+
+  auto step = [&](int thread_id) {
+    layer.for_each(bounds[thread_id], bounds[thread_id + 1], [&](uint64_t state_rank) {
+      for (const auto &next : neighbors(unrank(state_rank))) {
+        uint64_t next_rank = rank(next);
+        if (!vis.test(next_rank)) next_layer.set(next_rank);
+      }
+    });
+  };
+
+  // keep only the new states in next_layer, add them
+  // to vis, and clear layer so it can be filled next
+  auto settle = [&](int thread_id) {
+    uint64_t *old_words = layer.data();
+    uint64_t *new_words = next_layer.data();
+    uint64_t *vis_words = vis.data();
+    for (std::size_t block = block_cnt * thread_id / thread_count;
+         block < block_cnt * (thread_id + 1) / thread_count; ++block) {
+      std::size_t end = std::min(word_cnt, (block + 1) * block_words);
+      uint64_t count = 0;
+      for (std::size_t i = block * block_words; i < end; ++i) {
+        uint64_t fresh = new_words[i] & ~vis_words[i];
+        new_words[i] = fresh;
+        vis_words[i] |= fresh;
+        old_words[i] = 0;
+        count += __builtin_popcountll(fresh);
+      }
+      block_sizes[block] = count;
+    }
+  };
+
+  auto run = [&](auto &step) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+    for (auto &thread : threads) thread.join();
+  };
+
+  // settle next_layer and make it the layer
+  auto advance = [&]() {
+    run(settle);
+    std::swap(layer, next_layer);
+    layer_size = 0;
+    for (uint64_t size : block_sizes) layer_size += size;
+  };
+
+  advance();
+  while (layer_size) {
+    std::size_t block = 0;
+    uint64_t before = 0;
+    for (int thread_id = 1; thread_id < thread_count; ++thread_id) {
+      while (block < block_cnt &&
+             before + block_sizes[block] <= layer_size * thread_id / thread_count)
+        before += block_sizes[block++];
+      bounds[thread_id] = std::min(word_cnt, block * block_words);
+    }
+    bounds[thread_count] = word_cnt;
+
+    run(step);
+    advance();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class Rank, class Unrank>
+bool bfs_bitmap(Neighbors &&neighbors, const T &initial_state,
+                int thread_count, Rank &&rank, Unrank &&unrank,
+                uint64_t rank_count) {
+  return bfs_bitmap(std::forward<Neighbors>(neighbors),
+                    std::vector<T>{initial_state}, thread_count,
+                    std::forward<Rank>(rank), std::forward<Unrank>(unrank),
+                    rank_count);
+}
+
+/**
+ * Parallel bfs that keeps every layer in parent_layers,
+ * storing each state with the index of its parent in
+ * the previous layer, and stops after the first layer
+ * that has a state satisfying is_goal.
+ *
+ * Throws std::overflow_error before expanding a layer
+ * with more states than Index can tell apart.
+ *
+ * @tparam Index the type of the parent indices
+ * @return       the states of a shortest path from one of
+ *               initial_states to a goal, or nothing if no
+ *               goal is reachable
+ */
+template <class Neighbors, class T, class VisSet, class IsGoal,
+          class Index = uint32_t>
+std::optional<std::vector<T>> bfs_path(Neighbors &&neighbors,
+                                       const std::vector<T> &initial_states,
+                                       int thread_count, VisSet &&vis,
+                                       IsGoal &&is_goal) {
+  chunked_vector<T> sources(thread_count);
+  seed_layer(sources, vis, initial_states, thread_count);
+
+  parent_layers<T, Index> layers(thread_count);
+  auto &first_layer = layers.push_layer();
+  for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+    for (const auto &state : sources.chunk(thread_id)) {
+      if (is_goal(state)) return std::vector<T>{state};
+      first_layer.chunk(thread_id).emplace_back(state, 0);
+    }
+  sources.clear();
+  if (first_layer.size() && first_layer.size() - 1 > std::numeric_limits<Index>::max())
+    throw std::overflow_error("bfs_path: layer too large for Index");
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(layers.layer(0).split(0)) ranges;
+
+  // position in the chunk of each thread of
+  // the first goal it found, if any
+  std::vector<std::optional<std::size_t>> goals(thread_count);
+
+  std::size_t depth = 0;
+
+  auto step = [&](int thread_id) {
+    auto &layer = layers.layer(depth);
+    auto &new_queue = layers.layer(depth + 1).chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    std::size_t parent = begin - layer.begin();
+    for (; begin != end; ++begin, ++parent)
+      for (auto next : neighbors((*begin).first))
+        if (vis.emplace(next).second) {
+          new_queue.emplace_back(next, Index(parent));
+          if (!goals[thread_id] && is_goal(new_queue.back().first))
+            goals[thread_id] = new_queue.size() - 1;
+        }
+  };
+
+  while (layers.layer(depth).size()) {
+    ranges = layers.layer(depth).split(thread_count);
+    auto &next_layer = layers.push_layer();
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
+    for (auto &thread : threads) thread.join();
+
+    next_layer.seal();
+    ++depth;
+
+    std::size_t chunk_begin = 0;
     for (int thread_id = 0; thread_id < thread_count; ++thread_id) {
-      size_t begin = std::min(per_thread * thread_id, q_size);
-      size_t end = std::min(per_thread * (thread_id + 1), q_size);
-      threads[thread_id] = std::thread(step, thread_id, begin, end);
+      if (goals[thread_id])
+        return layers.path_to(depth, chunk_begin + *goals[thread_id]);
+      chunk_begin += next_layer.chunk(thread_id).size();
     }
 
+    // the states of the next layer will point into this one
+    if (next_layer.size() && next_layer.size() - 1 > std::numeric_limits<Index>::max())
+      throw std::overflow_error("bfs_path: layer too large for Index");
+  }
+
+  return std::nullopt;
+}
+
+template <class Neighbors, class T, class VisSet, class IsGoal,
+          class Index = uint32_t>
+std::optional<std::vector<T>> bfs_path(Neighbors &&neighbors,
+                                       const T &initial_state,
+                                       int thread_count, VisSet &&vis,
+                                       IsGoal &&is_goal) {
+  return bfs_path<Neighbors, T, VisSet, IsGoal, Index>(
+      std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+      thread_count, std::forward<VisSet>(vis), std::forward<IsGoal>(is_goal));
+}
+
+/**
+ * Parallel bidirectional bfs from source forward with
+ * neighbors and from target backward with predecessors,
+ * always expanding the side with the smaller layer.
+ *
+ * Every successor is looked up in the visited set of
+ * the other side, which is not written meanwhile. The
+ * first layer that meets the other side proves the
+ * distance, since before it the balls around source
+ * and target of the expanded depths were disjoint.
+ *
+ * @param forward_vis  the states reached from source,
+ *                     needs a thread safe contains
+ * @param backward_vis the states reached from target,
+ *                     needs a thread safe contains
+ * @return             the distance from source to target,
+ *                     or nothing if it is unreachable
+ */
+template <class Forward, class Backward, class T, class ForwardVisSet,
+          class BackwardVisSet>
+std::optional<std::size_t> bfs_bidirectional(
+    Forward &&neighbors, Backward &&predecessors, const T &source,
+    const T &target, int thread_count, ForwardVisSet &&forward_vis,
+    BackwardVisSet &&backward_vis) {
+  chunked_vector<T> forward_layer(thread_count);
+  chunked_vector<T> backward_layer(thread_count);
+  chunked_vector<T> next_layer(thread_count);
+  forward_layer.chunk(0).push_back(source);
+  backward_layer.chunk(0).push_back(target);
+
+  forward_vis.emplace(source);
+  backward_vis.emplace(target);
+  if (forward_vis.contains(target)) return 0;
+
+  std::vector<std::thread> threads(thread_count);
+  std::atomic<bool> met(false);
+
+  auto expand = [&](auto &transitions, chunked_vector<T> &layer, auto &vis,
+                    const auto &other_vis) {
+    auto ranges = layer.split(thread_count);
+
+    auto step = [&](int thread_id) {
+      auto &new_queue = next_layer.chunk(thread_id);
+      auto [begin, end] = ranges[thread_id];
+      while (begin != end && !met.load(std::memory_order_relaxed))
+        for (auto next : transitions(*(begin++))) {
+          if (other_vis.contains(next)) met.store(true, std::memory_order_relaxed);
+          if (vis.emplace(next).second) new_queue.push_back(next);
+        }
+    };
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+
     for (auto &thread : threads) thread.join();
+
+    std::swap(layer, next_layer);
+    next_layer.clear();
+  };
+
+  std::size_t forward_depth = 0, backward_depth = 0;
+  while (forward_layer.size() && backward_layer.size()) {
+    if (forward_layer.size() <= backward_layer.size()) {
+      expand(neighbors, forward_layer, forward_vis, backward_vis);
+      ++forward_depth;
+    } else {
+      expand(predecessors, backward_layer, backward_vis, forward_vis);
+      ++backward_depth;
+    }
+    if (met) return forward_depth + backward_depth;
+  }
+
+  return std::nullopt;
+}
+
+template <class Forward, class Backward, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+std::optional<std::size_t> bfs_phmap_bidirectional(
+    Forward &&neighbors, Backward &&predecessors, const T &source,
+    const T &target, int thread_count) {
+  using set_type =
+      phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                    4UL, std::mutex>;
+  set_type forward_vis, backward_vis;
+  return bfs_bidirectional(std::forward<Forward>(neighbors),
+                           std::forward<Backward>(predecessors), source, target,
+                           thread_count, forward_vis, backward_vis);
+}
+
+/**
+ * Like bfs_bitmap, but a layer may instead be found
+ * bottom-up: every unvisited state checks whether one
+ * of its predecessors is in the layer, stopping at the
+ * first one, which is far cheaper than expanding a
+ * layer that covers much of the unvisited states.
+ *
+ * Steps go bottom-up once the edges out of the layer
+ * outnumber the edges into the unvisited states divided
+ * by alpha, and go back top-down once the layer is
+ * shrinking and smaller than rank_count divided by beta.
+ * Both edge counts are estimated from the degrees of
+ * a random sample of the states. As predecessors builds
+ * every predecessor even when the check stops at the
+ * first, a bottom-up check costs the whole in-degree,
+ * hence alpha = 1. A larger alpha suits predecessors
+ * that are cheap to stop early.
+ *
+ * Every rank below rank_count must be the rank of a
+ * state, since bottom-up steps unrank the unvisited ranks.
+ *
+ * @param predecessors function giving the states that
+ *                     have a state as a neighbor
+ * @param alpha        must be positive
+ * @param beta         must be positive
+ */
+template <class Neighbors, class Predecessors, class T, class Rank,
+          class Unrank>
+bool bfs_direction_optimizing(Neighbors &&neighbors,
+                              Predecessors &&predecessors,
+                              const std::vector<T> &initial_states,
+                              int thread_count, Rank &&rank, Unrank &&unrank,
+                              uint64_t rank_count, uint64_t alpha = 1,
+                              uint64_t beta = 24) {
+  // layers are counted and split in blocks of this many words
+  constexpr std::size_t block_words = 64;
+
+  // states whose degree is sampled for an edge estimate,
+  // and words looked at to find them
+  constexpr int degree_samples = 64;
+  constexpr int probe_words = 1 << 10;
+
+  if (alpha == 0 || beta == 0)
+    throw std::invalid_argument("bfs_direction_optimizing: alpha and beta must be positive");
+
+  rank_bitmap layer(rank_count);
+  rank_bitmap next_layer(rank_count);
+  rank_bitmap vis(rank_count);
+
+  std::size_t word_cnt = layer.word_count();
+  std::size_t block_cnt = (word_cnt + block_words - 1) / block_words;
+  std::vector<uint64_t> block_sizes(block_cnt);
+  std::vector<std::size_t> bounds(thread_count + 1);
+
+  // the initial states go through settle like any later
+  // layer, which drops duplicates and counts the blocks
+  for (const auto &state : initial_states) next_layer.set(rank(state));
+  uint64_t layer_size = 0;
+  uint64_t vis_size = 0;
+  std::size_t depth = 0;
+
+  std::vector<std::thread> threads(thread_count);
+
+  auto unvisited_word = [&](std::size_t i) {
+    uint64_t unvisited = ~vis.data()[i];
+    if (i == word_cnt - 1 && rank_count % 64)
+      unvisited &= (uint64_t(1) << rank_count % 64) - 1;
+    return unvisited;
+  };
+
+  auto layer_word = [&](std::size_t i) {
+    return layer.data()[i];
+  };
+
+  // state_cnt times the mean degree of the states in
+  // the words given by word_at, sampling random words
+  auto edge_estimate = [&](auto &&word_at, uint64_t state_cnt, auto &&degree) {
+    uint64_t sampled = 0, degrees = 0;
+    for (int probe = 0; probe < probe_words && sampled < degree_samples; ++probe) {
+      uint64_t random = splitmix64(uint64_t(depth) << 32 | probe);
+      std::size_t i = random % word_cnt;
+      uint64_t word = word_at(i);
+      if (!word)
+        continue;
+      // the first state at or after a random bit
+      int bit = random >> 58;
+      uint64_t after = word >> bit << bit;
+      uint64_t state_rank = uint64_t(i) * 64 + __builtin_ctzll(after ? after : word);
+      degrees += degree(unrank(state_rank)).size();
+      ++sampled;
+    }
+    return sampled ? double(state_cnt) * degrees / sampled : 0.0;
+  };
+
+  auto top_down_step = [&](int thread_id) {
+    layer.for_each(bounds[thread_id], bounds[thread_id + 1], [&](uint64_t state_rank) {
+      for (const auto &next : neighbors(unrank(state_rank))) {
+        uint64_t next_rank = rank(next);
+        if (!vis.test(next_rank)) next_layer.set(next_rank);
+      }
+    });
+  };
+
+  auto bottom_up_step = [&](int thread_id) {
+    for (std::size_t i = bounds[thread_id]; i < bounds[thread_id + 1]; ++i) {
+      for (uint64_t unvisited = unvisited_word(i); unvisited;
+           unvisited &= unvisited - 1) {
+        uint64_t state_rank = uint64_t(i) * 64 + __builtin_ctzll(unvisited);
+        for (const auto &prev : predecessors(unrank(state_rank)))
+          if (layer.test(rank(prev))) {
+            next_layer.set(state_rank);
+            break;
+          }
+      }
+    }
+  };
+
+  // keep only the new states in next_layer, add them
+  // to vis, and clear layer so it can be filled next
+  auto settle = [&](int thread_id) {
+    uint64_t *old_words = layer.data();
+    uint64_t *new_words = next_layer.data();
+    uint64_t *vis_words = vis.data();
+    for (std::size_t block = block_cnt * thread_id / thread_count;
+         block < block_cnt * (thread_id + 1) / thread_count; ++block) {
+      std::size_t end = std::min(word_cnt, (block + 1) * block_words);
+      uint64_t count = 0;
+      for (std::size_t i = block * block_words; i < end; ++i) {
+        uint64_t fresh = new_words[i] & ~vis_words[i];
+        new_words[i] = fresh;
+        vis_words[i] |= fresh;
+        old_words[i] = 0;
+        count += __builtin_popcountll(fresh);
+      }
+      block_sizes[block] = count;
+    }
+  };
+
+  auto run = [&](auto &step) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+    for (auto &thread : threads) thread.join();
+  };
+
+  // settle next_layer and make it the layer
+  auto advance = [&]() {
+    run(settle);
+    std::swap(layer, next_layer);
+    layer_size = 0;
+    for (uint64_t size : block_sizes) layer_size += size;
+    vis_size += layer_size;
+  };
+
+  bool bottom_up = false;
+  uint64_t last_layer_size = 0;
+
+  for (advance(); layer_size; ++depth) {
+    if (!bottom_up) {
+      double layer_edges = edge_estimate(layer_word, layer_size, neighbors);
+      double unvisited_edges =
+          edge_estimate(unvisited_word, rank_count - vis_size, predecessors);
+      bottom_up = layer_edges > unvisited_edges / alpha;
+    } else if (layer_size < last_layer_size && layer_size < rank_count / beta) {
+      bottom_up = false;
+    }
+
+    if (bottom_up) {
+      // the work is in the unvisited states, which are spread out
+      for (int thread_id = 0; thread_id <= thread_count; ++thread_id)
+        bounds[thread_id] = word_cnt * thread_id / thread_count;
+    } else {
+      std::size_t block = 0;
+      uint64_t before = 0;
+      for (int thread_id = 1; thread_id < thread_count; ++thread_id) {
+        while (block < block_cnt &&
+               before + block_sizes[block] <= layer_size * thread_id / thread_count)
+          before += block_sizes[block++];
+        bounds[thread_id] = std::min(word_cnt, block * block_words);
+      }
+      bounds[0] = 0;
+      bounds[thread_count] = word_cnt;
+    }
+
+    if (bottom_up)
+      run(bottom_up_step);
+    else
+      run(top_down_step);
+
+    last_layer_size = layer_size;
+    advance();
   }
 
   return false;
 }
 
+template <class Neighbors, class Predecessors, class T, class Rank,
+          class Unrank>
+bool bfs_direction_optimizing(Neighbors &&neighbors,
+                              Predecessors &&predecessors,
+                              const T &initial_state, int thread_count,
+                              Rank &&rank, Unrank &&unrank,
+                              uint64_t rank_count, uint64_t alpha = 1,
+                              uint64_t beta = 24) {
+  return bfs_direction_optimizing(
+      std::forward<Neighbors>(neighbors),
+      std::forward<Predecessors>(predecessors), std::vector<T>{initial_state},
+      thread_count, std::forward<Rank>(rank), std::forward<Unrank>(unrank),
+      rank_count, alpha, beta);
+}
+
+/**
+ * Parallel bfs recording the depth of every reached
+ * state in depths, which is either a depth_map or a
+ * packed_depth_array, with key mapping states to the
+ * keys of depths, like a rank function.
+ *
+ * depths doubles as the visited set, so it can be
+ * queried for the depth of any state afterwards.
+ * Every distinct state of initial_states is at depth 0.
+ *
+ * Throws std::overflow_error if a state is deeper
+ * than Depths::max_depth.
+ */
+template <class Neighbors, class T, class Depths, class Key = identity_key>
+bool bfs_depths(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                int thread_count, Depths &depths, Key key = Key()) {
+  depth_recorder<Depths, Key> vis{depths, std::move(key)};
+  bool res = bfs(std::forward<Neighbors>(neighbors), initial_states,
+                 thread_count, vis,
+                 [&](const auto &, std::size_t depth) { vis.depth = depth + 1; });
+  if (vis.overflowed)
+    throw std::overflow_error("bfs_depths: a state is deeper than max_depth");
+  return res;
+}
+
+template <class Neighbors, class T, class Depths, class Key = identity_key>
+bool bfs_depths(Neighbors &&neighbors, const T &initial_state, int thread_count,
+                Depths &depths, Key key = Key()) {
+  return bfs_depths(std::forward<Neighbors>(neighbors),
+                    std::vector<T>{initial_state}, thread_count, depths,
+                    std::move(key));
+}
+
 template <class Neighbors, class T, class Hash = std::hash<T>,
           class KeyEqual = std::equal_to<T>>
-bool bfs_phmap(Neighbors &&neighbors, const T &initial_state,
-               int thread_count) {
+depth_map<T, Hash, KeyEqual> bfs_depth_map(Neighbors &&neighbors,
+                                           const std::vector<T> &initial_states,
+                                           int thread_count) {
+  depth_map<T, Hash, KeyEqual> depths;
+  bfs_depths(std::forward<Neighbors>(neighbors), initial_states, thread_count,
+             depths);
+  return depths;
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+depth_map<T, Hash, KeyEqual> bfs_depth_map(Neighbors &&neighbors,
+                                           const T &initial_state,
+                                           int thread_count) {
+  return bfs_depth_map<Neighbors, T, Hash, KeyEqual>(
+      std::forward<Neighbors>(neighbors), std::vector<T>{initial_state},
+      thread_count);
+}
+
+template <int Bits, class Neighbors, class T, class Rank>
+packed_depth_array<Bits> bfs_depth_array(Neighbors &&neighbors,
+                                         const std::vector<T> &initial_states,
+                                         int thread_count, Rank rank,
+                                         uint64_t rank_count) {
+  packed_depth_array<Bits> depths(rank_count);
+  bfs_depths(std::forward<Neighbors>(neighbors), initial_states, thread_count,
+             depths, std::move(rank));
+  return depths;
+}
+
+template <int Bits, class Neighbors, class T, class Rank>
+packed_depth_array<Bits> bfs_depth_array(Neighbors &&neighbors,
+                                         const T &initial_state,
+                                         int thread_count, Rank rank,
+                                         uint64_t rank_count) {
+  return bfs_depth_array<Bits>(std::forward<Neighbors>(neighbors),
+                               std::vector<T>{initial_state}, thread_count,
+                               std::move(rank), rank_count);
+}
+
+/**
+ * Parallel bfs for transitions costing 0 or 1, where
+ * neighbors gives (state, cost) pairs.
+ *
+ * Each layer holds the states at one distance. It is
+ * closed under 0 cost transitions in rounds, each
+ * expanding the states the previous round added, while
+ * the targets of 1 cost transitions are collected as
+ * candidates. Only once the layer is closed are the
+ * candidates filtered through vis into the next layer,
+ * so no state enters a layer deeper than its distance.
+ */
+template <class Neighbors, class T, class VisSet>
+bool bfs_zero_one(Neighbors &&neighbors, const std::vector<T> &initial_states,
+                  int thread_count, VisSet &&vis) {
+  chunked_vector<T> round(thread_count);
+  chunked_vector<T> next_round(thread_count);
+  chunked_vector<T> candidates(thread_count);
+  seed_layer(round, vis, initial_states, thread_count);
+
+  std::vector<std::thread> threads(thread_count);
+  decltype(round.split(0)) ranges;
+
+  auto expand = [&](int thread_id) {
+    auto &new_queue = next_round.chunk(thread_id);
+    auto &new_candidates = candidates.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    while (begin != end)
+      for (const auto &[next, cost] : neighbors(*(begin++))) {
+        if (cost)
+          new_candidates.push_back(next);
+        else if (vis.emplace(next).second)
+          new_queue.push_back(next);
+      }
+  };
+
+  auto filter = [&](int thread_id) {
+    auto &new_queue = next_round.chunk(thread_id);
+    auto [begin, end] = ranges[thread_id];
+    while (begin != end) {
+      const auto &candidate = *(begin++);
+      if (vis.emplace(candidate).second) new_queue.push_back(candidate);
+    }
+  };
+
+  auto run = [&](auto &step) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+    for (auto &thread : threads) thread.join();
+  };
+
+  while (round.size()) {
+    // close the layer under 0 cost transitions
+    while (round.size()) {
+      ranges = round.split(thread_count);
+      run(expand);
+      std::swap(round, next_round);
+      next_round.clear();
+    }
+
+    ranges = candidates.split(thread_count);
+    run(filter);
+    std::swap(round, next_round);
+    next_round.clear();
+    candidates.clear();
+  }
+
+  return false;
+}
+
+template <class Neighbors, class T, class VisSet>
+bool bfs_zero_one(Neighbors &&neighbors, const T &initial_state,
+                  int thread_count, VisSet &&vis) {
+  return bfs_zero_one(std::forward<Neighbors>(neighbors),
+                      std::vector<T>{initial_state}, thread_count,
+                      std::forward<VisSet>(vis));
+}
+
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+bool bfs_phmap_zero_one(Neighbors &&neighbors, const T &initial_state,
+                        int thread_count) {
   phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
                                 4UL, std::mutex>
       vis;
-  return bfs(std::forward<Neighbors>(neighbors), initial_state, thread_count, vis);
+  return bfs_zero_one(std::forward<Neighbors>(neighbors), initial_state,
+                      thread_count, vis);
 }
 
 template <class Neighbors, class T, class Hash = std::hash<T>,
           class KeyEqual = std::equal_to<T>>
-bool bfs_fixed_size_set(Neighbors &&neighbors, const T &initial_state,
-                        int thread_count, int hash_bit_count) {
-  fixed_size_set<T, Hash, KeyEqual> vis(hash_bit_count);
-  return bfs(std::forward<Neighbors>(neighbors), initial_state, thread_count, vis);
+bool bfs_phmap_zero_one(Neighbors &&neighbors,
+                        const std::vector<T> &initial_states,
+                        int thread_count) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  return bfs_zero_one(std::forward<Neighbors>(neighbors), initial_states,
+                      thread_count, vis);
+}
+
+/**
+ * Like bfs_phmap, but over the representatives that
+ * canonicalize gives for the symmetry classes, with
+ * the successors seen and replaced counted in stats.
+ *
+ * Every stored representative is also counted in
+ * stats, and orbit_size(representative), the size of
+ * its class, is summed into stats.represented, one call
+ * per state as each layer is complete. The default
+ * no_orbit_size skips this.
+ */
+template <class Neighbors, class Canonicalize, class T,
+          class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>,
+          class OrbitSize = no_orbit_size>
+bool bfs_phmap_symmetric(Neighbors &&neighbors, Canonicalize &&canonicalize,
+                         const std::vector<T> &initial_states, int thread_count,
+                         symmetry_stats &stats,
+                         OrbitSize &&orbit_size = OrbitSize()) {
+  phmap::parallel_flat_hash_set<T, Hash, KeyEqual, phmap::priv::Allocator<T>,
+                                4UL, std::mutex>
+      vis;
+  std::vector<T> initial_representatives;
+  initial_representatives.reserve(initial_states.size());
+  for (const auto &state : initial_states)
+    initial_representatives.push_back(canonicalize(state));
+
+  auto on_layer = [&](const auto &layer, std::size_t) {
+    stats.representatives += layer.size();
+    if constexpr (!std::is_same_v<std::decay_t<OrbitSize>, no_orbit_size>) {
+      uint64_t represented = 0;
+      for (const auto &state : layer) represented += orbit_size(state);
+      stats.represented += represented;
+    }
+  };
+
+  return bfs(make_canonical_neighbors(std::forward<Neighbors>(neighbors),
+                                      std::forward<Canonicalize>(canonicalize),
+                                      stats),
+             initial_representatives, thread_count, vis, on_layer);
+}
+
+template <class Neighbors, class Canonicalize, class T,
+          class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>,
+          class OrbitSize = no_orbit_size>
+bool bfs_phmap_symmetric(Neighbors &&neighbors, Canonicalize &&canonicalize,
+                         const T &initial_state, int thread_count,
+                         symmetry_stats &stats,
+                         OrbitSize &&orbit_size = OrbitSize()) {
+  return bfs_phmap_symmetric<Neighbors, Canonicalize, T, Hash, KeyEqual,
+                             OrbitSize>(
+      std::forward<Neighbors>(neighbors),
+      std::forward<Canonicalize>(canonicalize), std::vector<T>{initial_state},
+      thread_count, stats, std::forward<OrbitSize>(orbit_size));
 }
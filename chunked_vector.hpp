@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <iterator>
+#include <memory>
 #include <tuple>
+#include <utility>
 #include <vector>
 
+#include "segmented_chunk.hpp"
+
 /**
  * Data structure that behaves both like
  * multiple vectors and a single vector
@@ -11,9 +16,14 @@
  *
  * Each chunk can be written to by a single thread.
  *
- * @tparam T the type to store
+ * Once all chunks are filled, the vector can be sealed,
+ * which records where each chunk starts so that random
+ * access and splitting don't have to walk the chunks.
+ *
+ * @tparam T         the type to store
+ * @tparam Allocator the allocator used for the chunks
  */
-template<class T>
+template<class T, class Allocator = std::allocator<T>>
 class chunked_vector {
 
   template<class DerefType, class VectorRefType>
@@ -34,9 +44,13 @@ class chunked_vector {
    * Constructs the chunked vector.
    *
    * @param chunk_cnt the number of chunks to create
+   * @param alloc     the allocator to copy into every chunk
    */
-  chunked_vector(size_t chunk_cnt) :
-    chunks_(chunk_cnt) {}
+  chunked_vector(size_t chunk_cnt, const Allocator &alloc = Allocator()) {
+    chunks_.reserve(chunk_cnt);
+    for (size_t i = 0; i < chunk_cnt; ++i)
+      chunks_.emplace_back(alloc);
+  }
 
   /**
    * Find the number of elements.
@@ -47,6 +61,8 @@ class chunked_vector {
    *         in total (across all chunks)
    */
   size_t size() const {
+    if (sealed_)
+      return offsets_.back();
     size_t res = 0;
     for (const auto &chunk : chunks_)
       res += chunk.size();
@@ -54,13 +70,56 @@ class chunked_vector {
   }
 
   /**
-   * Remove all elements.
+   * Remove all elements, and unseal the vector.
    *
    * Not thread safe.
    */
   void clear() {
     for (auto &chunk : chunks_)
       chunk.clear();
+    sealed_ = false;
+  }
+
+  /**
+   * Record the prefix sums of the chunk sizes,
+   * making size(), end() and moving iterators
+   * across chunks independent of the chunk walk.
+   *
+   * The chunks must not change size until clear().
+   *
+   * Not thread safe.
+   */
+  void seal() {
+    offsets_.resize(chunks_.size() + 1);
+    offsets_[0] = 0;
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      offsets_[i + 1] = offsets_[i] + chunks_[i].size();
+    sealed_ = true;
+  }
+
+  /**
+   * Split the vector into contiguous ranges of
+   * sizes differing by at most one, sealing it
+   * first if it is not already.
+   *
+   * Not thread safe.
+   *
+   * @param part_cnt the number of ranges
+   * @return         part_cnt pairs of begin and end iterators
+   */
+  std::vector<std::pair<iterator, iterator>> split(size_t part_cnt) {
+    if (!sealed_)
+      seal();
+    size_t total = size();
+    std::vector<std::pair<iterator, iterator>> parts;
+    parts.reserve(part_cnt);
+    iterator part_begin = begin();
+    for (size_t i = 0; i < part_cnt; ++i) {
+      iterator part_end(this, total * (i + 1) / part_cnt);
+      parts.emplace_back(part_begin, part_end);
+      part_begin = part_end;
+    }
+    return parts;
   }
 
   /**
@@ -79,6 +138,14 @@ class chunked_vector {
     return iterator(this, size());
   }
 
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const {
+    return const_iterator(this, size());
+  }
+
   /**
    * Access a chunk.
    *
@@ -89,13 +156,32 @@ class chunked_vector {
    * @param chunk_index the index of the chunk to access
    * @return            a reference to the chunk
    */
-  std::vector<T> &chunk(size_t chunk_index) {
+  segmented_chunk<T, Allocator> &chunk(size_t chunk_index) {
+    return chunks_[chunk_index];
+  }
+
+  const segmented_chunk<T, Allocator> &chunk(size_t chunk_index) const {
     return chunks_[chunk_index];
   }
 
+  /**
+   * @return the number of chunks
+   */
+  size_t chunk_count() const {
+    return chunks_.size();
+  }
+
  private:
 
-  std::vector<std::vector<T>> chunks_;
+  std::vector<segmented_chunk<T, Allocator>> chunks_;
+
+  /**
+   * When sealed, offsets_[i] is the position of
+   * the first element of chunk i, and offsets_.back()
+   * is the total size.
+   */
+  std::vector<size_t> offsets_;
+  bool sealed_ = false;
 
 };
 
@@ -108,9 +194,9 @@ class chunked_vector {
  * @tparam DerefType     the type the iterator yields
  * @tparam VectorRefType the type of the reference to the iterated chunked_vector
  */
-template<class T>
+template<class T, class Allocator>
 template<class DerefType, class VectorRefType>
-class chunked_vector<T>::iterator_base
+class chunked_vector<T, Allocator>::iterator_base
 : public std::iterator<std::random_access_iterator_tag, T> {
   friend class chunked_vector;
 
@@ -136,38 +222,42 @@ class chunked_vector<T>::iterator_base
     return vector_ref_->chunks_[chunk_id_][chunk_position_];
   }
 
-  iterator &operator+=(ptrdiff_t offset) {
+  iterator_base &operator+=(ptrdiff_t offset) {
     position_ += offset;
     chunk_position_ += offset;
-    skip();
+    // only look for another chunk when
+    // leaving the current one
+    if (chunk_position_ < 0 || chunk_id_ >= vector_ref_->chunks_.size()
+        || chunk_position_ >= (ptrdiff_t)vector_ref_->chunks_[chunk_id_].size())
+      skip();
     return *this;
   }
 
-  iterator &operator-=(ptrdiff_t offset) {
+  iterator_base &operator-=(ptrdiff_t offset) {
     return *this += -offset;
   }
 
-  iterator &operator++() {
+  iterator_base &operator++() {
     return *this += 1;
   }
 
-  iterator &operator--() {
+  iterator_base &operator--() {
     return *this -= 1;
   }
 
-  iterator operator+(ptrdiff_t offset) const {
-    iterator cpy = *this;
+  iterator_base operator+(ptrdiff_t offset) const {
+    iterator_base cpy = *this;
     cpy += offset;
     return cpy;
   }
 
-  iterator operator-(ptrdiff_t offset) const {
-    iterator cpy = *this;
+  iterator_base operator-(ptrdiff_t offset) const {
+    iterator_base cpy = *this;
     cpy -= offset;
     return cpy;
   }
 
-  friend iterator operator+(ptrdiff_t offset, const iterator &it) {
+  friend iterator_base operator+(ptrdiff_t offset, const iterator_base &it) {
     return it + offset;
   }
 
@@ -175,37 +265,47 @@ class chunked_vector<T>::iterator_base
     return *(*this + offset);
   }
 
-  iterator operator++(int) {
-    iterator cpy = *this;
+  iterator_base operator++(int) {
+    iterator_base cpy = *this;
     ++*this;
     return cpy;
   }
 
-  iterator operator--(int) {
-    iterator cpy = *this;
-    --this;
+  iterator_base operator--(int) {
+    iterator_base cpy = *this;
+    --*this;
     return cpy;
   }
 
-  ptrdiff_t operator-(const iterator &o) const {
+  ptrdiff_t operator-(const iterator_base &o) const {
     return position_ - o.position_;
   }
 
-  friend bool operator==(const iterator &l, const iterator &r) { return l.position_ == r.position_; }
-  friend bool operator!=(const iterator &l, const iterator &r) { return l.position_ != r.position_; }
-  friend bool operator< (const iterator &l, const iterator &r) { return l.position_ <  r.position_; }
-  friend bool operator<=(const iterator &l, const iterator &r) { return l.position_ <= r.position_; }
-  friend bool operator>=(const iterator &l, const iterator &r) { return l.position_ >= r.position_; }
-  friend bool operator> (const iterator &l, const iterator &r) { return l.position_ >  r.position_; }
+  friend bool operator==(const iterator_base &l, const iterator_base &r) { return l.position_ == r.position_; }
+  friend bool operator!=(const iterator_base &l, const iterator_base &r) { return l.position_ != r.position_; }
+  friend bool operator< (const iterator_base &l, const iterator_base &r) { return l.position_ <  r.position_; }
+  friend bool operator<=(const iterator_base &l, const iterator_base &r) { return l.position_ <= r.position_; }
+  friend bool operator>=(const iterator_base &l, const iterator_base &r) { return l.position_ >= r.position_; }
+  friend bool operator> (const iterator_base &l, const iterator_base &r) { return l.position_ >  r.position_; }
 
  private:
 
-  const VectorRefType vector_ref_;
+  VectorRefType vector_ref_;
   size_t position_;
   size_t chunk_id_;
   ptrdiff_t chunk_position_;
 
   void skip() {
+    if (vector_ref_->sealed_) {
+      // the chunk holding position_ is the
+      // last one starting at or before it
+      const auto &offsets = vector_ref_->offsets_;
+      chunk_id_ = std::upper_bound(offsets.begin(), offsets.end() - 1, position_)
+                - offsets.begin() - 1;
+      chunk_position_ = position_ - offsets[chunk_id_];
+      return;
+    }
+
     // change to a further ahead chunk while
     // the position within the chunk
     // is greater than the size of the chunk
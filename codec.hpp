@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Codec storing states as their raw bytes.
+ *
+ * Codecs encode a state by appending bytes to a buffer,
+ * and decode it from a pointer into a buffer, returning
+ * the pointer past what was read. Codecs used with
+ * arena_layer also give a view of an encoded state,
+ * which neighbors can read without decoding it.
+ *
+ * @tparam T the type to encode, must be trivially copyable
+ */
+template<class T>
+struct trivial_codec {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "trivial_codec copies the raw bytes of the state");
+
+  /**
+   * A trivially copyable state is its own view.
+   */
+  using view_type = T;
+
+  void encode(const T &value, std::vector<char> &out) const {
+    const char *bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+  }
+
+  const char *decode(const char *in, T &value) const {
+    std::memcpy(&value, in, sizeof(T));
+    return in + sizeof(T);
+  }
+
+  view_type view(const char *bytes, size_t) const {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+  }
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Layer of a search over a rankable state space,
+ * storing the ranks of its states compressed.
+ *
+ * Each chunk is sorted and stored as deltas between
+ * consecutive ranks, encoded as varints, in blocks
+ * that each start from an uncompressed rank. Blocks
+ * decode independently, so a layer can be decoded by
+ * many threads at once, and dense layers take one or
+ * two bytes per state instead of a whole state.
+ *
+ * Each chunk can be written to by a single thread.
+ */
+class compressed_layer {
+
+  struct block {
+    uint64_t first;
+    size_t offset;
+    size_t count;
+  };
+
+  struct run {
+    std::vector<uint8_t> bytes;
+    std::vector<block> blocks;
+  };
+
+ public:
+
+  /**
+   * Number of ranks in every block but
+   * the last of each chunk.
+   */
+  static constexpr size_t block_size = 256;
+
+  /**
+   * Constructs the layer.
+   *
+   * @param chunk_cnt the number of chunks to create
+   */
+  explicit compressed_layer(size_t chunk_cnt) :
+    runs_(chunk_cnt) {}
+
+  /**
+   * Sort, deduplicate and compress ranks into a chunk,
+   * replacing what it held before.
+   *
+   * Thread safe as long as any single chunk_index
+   * is used by at most 1 thread.
+   *
+   * @param chunk_index the index of the chunk to fill
+   * @param ranks       the ranks to store, which are left sorted
+   */
+  void compress_chunk(size_t chunk_index, std::vector<uint64_t> &ranks) {
+    std::sort(ranks.begin(), ranks.end());
+    ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+
+    run &out = runs_[chunk_index];
+    out.bytes.clear();
+    out.blocks.clear();
+
+    for (size_t i = 0; i < ranks.size(); i += block_size) {
+      size_t end = std::min(ranks.size(), i + block_size);
+      out.blocks.push_back({ranks[i], out.bytes.size(), end - i});
+      for (size_t j = i + 1; j < end; ++j)
+        put_varint(out.bytes, ranks[j] - ranks[j - 1]);
+    }
+  }
+
+  /**
+   * Remove all ranks, keeping the memory.
+   *
+   * Not thread safe.
+   */
+  void clear() {
+    for (auto &chunk : runs_) {
+      chunk.bytes.clear();
+      chunk.blocks.clear();
+    }
+  }
+
+  /**
+   * Find the number of elements.
+   *
+   * @return the number of ranks in all chunks
+   */
+  size_t size() const {
+    size_t res = 0;
+    for (const auto &chunk : runs_)
+      for (const auto &b : chunk.blocks)
+        res += b.count;
+    return res;
+  }
+
+  /**
+   * @return the number of bytes used for the
+   *         compressed ranks and the block index
+   */
+  size_t byte_size() const {
+    size_t res = 0;
+    for (const auto &chunk : runs_)
+      res += chunk.bytes.size() + chunk.blocks.size() * sizeof(block);
+    return res;
+  }
+
+  /**
+   * Decode part of the layer, splitting the blocks
+   * of all chunks evenly between part_cnt parts.
+   *
+   * Thread safe due to not mutating anything.
+   *
+   * @param part     which part to decode, in [0, part_cnt)
+   * @param part_cnt how many parts the layer is split into
+   * @param f        the function to call with every rank
+   */
+  template<class F>
+  void for_each(size_t part, size_t part_cnt, F &&f) const {
+    size_t block_cnt = 0;
+    for (const auto &chunk : runs_)
+      block_cnt += chunk.blocks.size();
+
+    size_t begin = block_cnt * part / part_cnt;
+    size_t end = block_cnt * (part + 1) / part_cnt;
+
+    size_t chunk_begin = 0;
+    for (const auto &chunk : runs_) {
+      size_t chunk_end = chunk_begin + chunk.blocks.size();
+      for (size_t i = std::max(begin, chunk_begin); i < std::min(end, chunk_end); ++i)
+        decode_block(chunk, chunk.blocks[i - chunk_begin], f);
+      chunk_begin = chunk_end;
+    }
+  }
+
+ private:
+
+  std::vector<run> runs_;
+
+  static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+      out.push_back(uint8_t(value) | 0x80);
+      value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+  }
+
+  template<class F>
+  static void decode_block(const run &chunk, const block &b, F &f) {
+    const uint8_t *in = chunk.bytes.data() + b.offset;
+    uint64_t rank = b.first;
+    f(rank);
+    for (size_t i = 1; i < b.count; ++i) {
+      uint64_t delta = 0;
+      int shift = 0;
+      for (;;) {
+        uint8_t byte = *in++;
+        delta |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+          break;
+        shift += 7;
+      }
+      rank += delta;
+      f(rank);
+    }
+  }
+
+};
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "splitmix64.hpp"
+
+/**
+ * Approximate set for use by multiple threads at once,
+ * storing only a 16-bit fingerprint of every key.
+ *
+ * Every key has two candidate buckets of four
+ * fingerprints each, and a new key that finds both
+ * full evicts fingerprints to their other bucket.
+ * Unlike a Bloom filter this allows erasing keys,
+ * so states can be forgotten to keep the memory
+ * proportional to the part of the search still active.
+ *
+ * Membership has false positives: a key can be reported
+ * as present because another key has the same fingerprint
+ * and buckets. Only erase keys that emplace reported as
+ * inserted, otherwise the fingerprint of a different key
+ * may be the one removed.
+ *
+ * @tparam Key  The type of the keys to remember
+ * @tparam Hash Function-object type for hasing keys
+ */
+template<
+ class Key,
+ class Hash = std::hash<Key>
+> class cuckoo_filter {
+ public:
+
+  /**
+   * Constructs the filter.
+   *
+   * @param bits Number of buckets will be 1<<bits,
+   *             each holding 4 fingerprints
+   * @param seed Used in post-hash to make adversarial
+   *             input hard to create
+   * @param hash Instance to use of the Hash function-object type
+   */
+  cuckoo_filter(
+      int bits,
+      uint64_t seed = std::chrono::steady_clock::now().time_since_epoch().count(),
+      const Hash &hash = Hash()) :
+    fixed_random_(seed),
+    hash_(hash),
+    bits_(bits),
+    buckets_(size_t(1) << bits),
+    locks_(size_t(1) << std::min(bits, max_lock_bits)),
+    rng_(seed) {}
+
+  /**
+   * @brief holds a member
+   * boolean with the name
+   * second to allow drop in
+   * replacement for std::set
+   */
+  struct second_holder {
+    bool second;
+    operator bool() {
+      return second;
+    }
+  };
+
+  /**
+   * Insert a key in the filter if it is not there,
+   * and return whether it was already there.
+   *
+   * @param  key The key to insert
+   * @return true if the element was inserted,
+   *         and false if it (or a key with the
+   *         same fingerprint) was already there.
+   */
+  second_holder emplace(const Key &key) {
+    auto [fingerprint, index1, index2] = locate(key);
+
+    {
+      std::shared_lock<std::shared_mutex> table_lock(table_mutex_);
+      auto bucket_locks = lock_buckets(index1, index2);
+      if (bucket_has(index1, fingerprint) || bucket_has(index2, fingerprint)
+          || stash_has(fingerprint, index1, index2))
+        return {false};
+      if (bucket_put(index1, fingerprint) || bucket_put(index2, fingerprint))
+        return {true};
+    }
+
+    // both buckets are full, so fingerprints must be moved
+    // around, which is done with every other thread excluded
+    std::unique_lock<std::shared_mutex> table_lock(table_mutex_);
+    if (bucket_has(index1, fingerprint) || bucket_has(index2, fingerprint)
+        || stash_has(fingerprint, index1, index2))
+      return {false};
+    relocate(fingerprint, index1);
+    return {true};
+  }
+
+  /**
+   * Check whether a key is in the filter.
+   *
+   * @param  key The key to look for
+   * @return true if the key was inserted and not erased,
+   *         or if a key with the same fingerprint was
+   */
+  bool contains(const Key &key) {
+    auto [fingerprint, index1, index2] = locate(key);
+    std::shared_lock<std::shared_mutex> table_lock(table_mutex_);
+    auto bucket_locks = lock_buckets(index1, index2);
+    return bucket_has(index1, fingerprint) || bucket_has(index2, fingerprint)
+        || stash_has(fingerprint, index1, index2);
+  }
+
+  /**
+   * Remove a key from the filter.
+   *
+   * @param  key The key to remove, which must have been inserted
+   * @return true if a fingerprint for the key was removed
+   */
+  bool erase(const Key &key) {
+    auto [fingerprint, index1, index2] = locate(key);
+
+    {
+      std::shared_lock<std::shared_mutex> table_lock(table_mutex_);
+      auto bucket_locks = lock_buckets(index1, index2);
+      if (bucket_take(index1, fingerprint) || bucket_take(index2, fingerprint))
+        return true;
+      if (stash_.empty())
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> table_lock(table_mutex_);
+    if (bucket_take(index1, fingerprint) || bucket_take(index2, fingerprint))
+      return true;
+    for (auto it = stash_.begin(); it != stash_.end(); ++it) {
+      if (it->first == fingerprint && (it->second == index1 || it->second == index2)) {
+        stash_.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+
+  static constexpr int max_lock_bits = 16;
+  static constexpr int slots_per_bucket = 4;
+  static constexpr int max_kicks = 500;
+
+  const uint64_t fixed_random_;
+  Hash hash_;
+
+  const int bits_;
+
+  /**
+   * Each bucket packs four 16-bit fingerprints,
+   * where a fingerprint of 0 is an empty slot.
+   */
+  std::vector<uint64_t> buckets_;
+  std::vector<std::mutex> locks_;
+  std::shared_mutex table_mutex_;
+
+  /**
+   * Fingerprints (with one of their buckets) that
+   * could not be placed when the table is nearly full.
+   * Only modified with table_mutex_ held exclusively.
+   */
+  std::vector<std::pair<uint16_t, size_t>> stash_;
+  std::minstd_rand rng_;
+
+  struct location {
+    uint16_t fingerprint;
+    size_t index1;
+    size_t index2;
+  };
+
+  size_t mask() const {
+    return (size_t(1) << bits_) - 1;
+  }
+
+  /**
+   * @brief finds the alternative bucket of a fingerprint,
+   * which maps index1 to index2 and index2 back to index1
+   */
+  size_t other_index(size_t index, uint16_t fingerprint) const {
+    return (index ^ splitmix64(fingerprint)) & mask();
+  }
+
+  location locate(const Key &key) const {
+    uint64_t hash = splitmix64(hash_(key) + fixed_random_);
+    auto fingerprint = uint16_t(hash >> 48);
+    if (fingerprint == 0)
+      fingerprint = 1;
+    size_t index1 = hash & mask();
+    return {fingerprint, index1, other_index(index1, fingerprint)};
+  }
+
+  /**
+   * @brief locks the stripes of both buckets
+   * in a fixed order to avoid deadlock
+   */
+  std::pair<std::unique_lock<std::mutex>, std::unique_lock<std::mutex>>
+  lock_buckets(size_t index1, size_t index2) {
+    size_t stripe1 = index1 & (locks_.size() - 1);
+    size_t stripe2 = index2 & (locks_.size() - 1);
+    if (stripe1 > stripe2)
+      std::swap(stripe1, stripe2);
+    std::unique_lock<std::mutex> first(locks_[stripe1]);
+    if (stripe1 == stripe2)
+      return {std::move(first), std::unique_lock<std::mutex>()};
+    return {std::move(first), std::unique_lock<std::mutex>(locks_[stripe2])};
+  }
+
+  static uint16_t slot(uint64_t bucket, int i) {
+    return uint16_t(bucket >> (16 * i));
+  }
+
+  bool bucket_has(size_t index, uint16_t fingerprint) const {
+    for (int i = 0; i < slots_per_bucket; ++i)
+      if (slot(buckets_[index], i) == fingerprint)
+        return true;
+    return false;
+  }
+
+  bool bucket_put(size_t index, uint16_t fingerprint) {
+    for (int i = 0; i < slots_per_bucket; ++i) {
+      if (slot(buckets_[index], i) == 0) {
+        buckets_[index] |= uint64_t(fingerprint) << (16 * i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool bucket_take(size_t index, uint16_t fingerprint) {
+    for (int i = 0; i < slots_per_bucket; ++i) {
+      if (slot(buckets_[index], i) == fingerprint) {
+        buckets_[index] &= ~(uint64_t(0xffff) << (16 * i));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool stash_has(uint16_t fingerprint, size_t index1, size_t index2) const {
+    for (auto [in_stash, index] : stash_)
+      if (in_stash == fingerprint && (index == index1 || index == index2))
+        return true;
+    return false;
+  }
+
+  /**
+   * @brief places a fingerprint by evicting random
+   * victims to their alternative bucket, the caller
+   * must hold table_mutex_ exclusively
+   */
+  void relocate(uint16_t fingerprint, size_t index) {
+    for (int kick = 0; kick < max_kicks; ++kick) {
+      int victim = rng_() % slots_per_bucket;
+      uint16_t evicted = slot(buckets_[index], victim);
+      buckets_[index] &= ~(uint64_t(0xffff) << (16 * victim));
+      buckets_[index] |= uint64_t(fingerprint) << (16 * victim);
+
+      fingerprint = evicted;
+      index = other_index(index, fingerprint);
+      if (bucket_put(index, fingerprint))
+        return;
+    }
+    stash_.emplace_back(fingerprint, index);
+  }
+
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel_hashmap/phmap.h"
+
+/**
+ * Concurrent map from a state to the cost
+ * of the cheapest known path to it.
+ */
+template<class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+using distance_map =
+    phmap::parallel_flat_hash_map<T, uint64_t, Hash, KeyEqual,
+                                  phmap::priv::Allocator<std::pair<const T, uint64_t>>,
+                                  4UL, std::mutex>;
+
+/**
+ * Buckets of entries numbered from 0 up, kept in a ring
+ * of vectors indexed by the bucket number modulo its
+ * size, which doubles whenever a bucket would not fit
+ * beside the lowest one in use, up to max_ring_size.
+ * Buckets beyond the ring wait in a sorted overflow map
+ * until advance_to() brings them within reach, so that
+ * one costly transition costs one map entry rather than
+ * a slot for every bucket up to it. Taken buckets leave
+ * their memory behind for later buckets.
+ *
+ * Not thread safe.
+ */
+template<class Entry>
+class bucket_ring {
+ public:
+
+  static constexpr std::size_t max_ring_size = 1 << 10;
+
+  bucket_ring() : ring_(1) {}
+
+  /**
+   * Add an entry to a bucket.
+   *
+   * @param bucket the bucket number, at least the
+   *               last one passed to advance_to()
+   */
+  void push(uint64_t bucket, Entry entry) {
+    if (bucket - first_ >= ring_.size() && ring_.size() < max_ring_size)
+      grow(std::min<uint64_t>(bucket - first_ + 1, max_ring_size));
+    if (bucket - first_ >= ring_.size()) {
+      overflow_[bucket].push_back(std::move(entry));
+      return;
+    }
+    ring_[bucket & (ring_.size() - 1)].push_back(std::move(entry));
+    end_ = std::max(end_, bucket + 1);
+  }
+
+  /**
+   * @return the lowest bucket holding an entry,
+   *         or nothing if every bucket is empty
+   */
+  std::optional<uint64_t> lowest() const {
+    for (uint64_t bucket = first_; bucket < end_; ++bucket)
+      if (!ring_[bucket & (ring_.size() - 1)].empty())
+        return bucket;
+    if (!overflow_.empty())
+      return overflow_.begin()->first;
+    return std::nullopt;
+  }
+
+  /**
+   * Promise that no entry will be added to a bucket
+   * below first, which must hold no entries.
+   */
+  void advance_to(uint64_t first) {
+    first_ = std::max(first_, first);
+    end_ = std::max(end_, first_);
+    drain_overflow();
+  }
+
+  /**
+   * Swap the entries of a bucket with out,
+   * which should be empty.
+   */
+  void take(uint64_t bucket, std::vector<Entry> &out) {
+    if (bucket >= first_ && bucket < end_) {
+      std::swap(ring_[bucket & (ring_.size() - 1)], out);
+    } else if (auto it = overflow_.find(bucket); it != overflow_.end()) {
+      std::swap(it->second, out);
+      overflow_.erase(it);
+    }
+  }
+
+ private:
+
+  std::vector<std::vector<Entry>> ring_;
+  std::map<uint64_t, std::vector<Entry>> overflow_;
+  uint64_t first_ = 0;
+  uint64_t end_ = 0;
+
+  void grow(uint64_t span) {
+    std::size_t size = ring_.size();
+    while (size < span) size *= 2;
+    std::vector<std::vector<Entry>> ring(size);
+    for (uint64_t bucket = first_; bucket < end_; ++bucket)
+      std::swap(ring[bucket & (size - 1)], ring_[bucket & (ring_.size() - 1)]);
+    std::swap(ring_, ring);
+    drain_overflow();
+  }
+
+  // move the overflowing buckets that now fit into the ring
+  void drain_overflow() {
+    while (!overflow_.empty() &&
+           overflow_.begin()->first - first_ < ring_.size()) {
+      auto it = overflow_.begin();
+      auto &slot = ring_[it->first & (ring_.size() - 1)];
+      if (slot.empty())
+        std::swap(slot, it->second);
+      else
+        std::move(it->second.begin(), it->second.end(), std::back_inserter(slot));
+      end_ = std::max(end_, it->first + 1);
+      overflow_.erase(it);
+    }
+  }
+
+};
+
+/**
+ * Parallel delta-stepping shortest paths for
+ * transitions with non-negative integer costs.
+ *
+ * Tentative distances are kept in a distance_map,
+ * and states wait in buckets of width delta by
+ * distance, each thread keeping its own bucket_ring.
+ * The lowest bucket is expanded in parallel over
+ * light transitions (cost at most delta) until it
+ * stays empty, and only then are the heavy
+ * transitions found meanwhile relaxed, as they
+ * can only land in later buckets.
+ *
+ * A state is pushed with its distance each time relax
+ * lowers it, and is expanded from every such entry
+ * without looking the distance up again, as entries
+ * that were improved on meanwhile only produce
+ * successors that fail to relax. With unit costs and
+ * delta = 1 this is a layered search much like bfs,
+ * where a bucket is a layer, and no state is ever
+ * pushed twice.
+ *
+ * @param neighbors    function giving (state, cost) pairs for a state
+ * @param thread_count the number of threads to use
+ * @param delta        the bucket width
+ * @return             the distance to every reachable state
+ */
+template <class Neighbors, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+distance_map<T, Hash, KeyEqual> delta_stepping(Neighbors &&neighbors,
+                                               const T &initial_state,
+                                               int thread_count,
+                                               uint64_t delta = 1) {
+  using entry = std::pair<T, uint64_t>;
+
+  distance_map<T, Hash, KeyEqual> dist;
+  dist.emplace(initial_state, 0);
+
+  // bucket i of buckets[thread_id] holds the states that
+  // thread found with a distance in [i * delta, (i + 1) * delta)
+  std::vector<bucket_ring<entry>> buckets(thread_count);
+  buckets[0].push(0, entry(initial_state, 0));
+
+  std::vector<std::vector<entry>> frontier(thread_count);
+  std::vector<std::vector<entry>> heavy(thread_count);
+  std::vector<std::thread> threads(thread_count);
+  std::size_t frontier_size;
+
+  // lower the distance of a state, and return
+  // whether it was improved
+  auto relax = [&](const T &state, uint64_t distance) {
+    bool improved = false;
+    dist.lazy_emplace_l(
+        state,
+        [&](auto &stored) {
+          if (distance < stored.second) {
+            stored.second = distance;
+            improved = true;
+          }
+        },
+        [&](const auto &construct) {
+          construct(state, distance);
+          improved = true;
+        });
+    return improved;
+  };
+
+  auto push = [&](int thread_id, const T &state, uint64_t distance) {
+    buckets[thread_id].push(distance / delta, entry(state, distance));
+  };
+
+  auto light_step = [&](int thread_id) {
+    // the part of the frontier, as if its chunks were concatenated
+    std::size_t begin = frontier_size * thread_id / thread_count;
+    std::size_t end = frontier_size * (thread_id + 1) / thread_count;
+    std::size_t chunk_begin = 0;
+    for (const auto &chunk : frontier) {
+      std::size_t chunk_end = chunk_begin + chunk.size();
+      for (std::size_t i = std::max(begin, chunk_begin); i < std::min(end, chunk_end); ++i) {
+        const auto &[state, distance] = chunk[i - chunk_begin];
+        for (const auto &[next, cost] : neighbors(state)) {
+          if (cost > delta)
+            heavy[thread_id].emplace_back(next, distance + cost);
+          else if (relax(next, distance + cost))
+            push(thread_id, next, distance + cost);
+        }
+      }
+      chunk_begin = chunk_end;
+    }
+  };
+
+  auto heavy_step = [&](int thread_id) {
+    for (const auto &[state, distance] : heavy[thread_id])
+      if (relax(state, distance))
+        push(thread_id, state, distance);
+    heavy[thread_id].clear();
+  };
+
+  auto run = [&](auto &step) {
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(step, thread_id);
+    for (auto &thread : threads) thread.join();
+  };
+
+  for (;;) {
+    std::optional<uint64_t> current;
+    for (const auto &own : buckets) {
+      auto lowest = own.lowest();
+      if (lowest && (!current || *lowest < *current))
+        current = lowest;
+    }
+    if (!current)
+      break;
+    for (auto &own : buckets)
+      own.advance_to(*current);
+
+    for (;;) {
+      frontier_size = 0;
+      for (int thread_id = 0; thread_id < thread_count; ++thread_id) {
+        frontier[thread_id].clear();
+        buckets[thread_id].take(*current, frontier[thread_id]);
+        frontier_size += frontier[thread_id].size();
+      }
+      if (!frontier_size)
+        break;
+      run(light_step);
+    }
+
+    run(heavy_step);
+  }
+
+  return dist;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel_hashmap/phmap.h"
+
+/**
+ * The depth of every rank of a rankable state space,
+ * packed into Bits bits per rank, where 0 means the
+ * rank is not reached and d + 1 means depth d.
+ *
+ * try_set() may be called concurrently, using a compare
+ * and swap on the 64 bit word holding the rank.
+ *
+ * @tparam Bits bits per rank, 4 or 8
+ */
+template<int Bits>
+class packed_depth_array {
+  static_assert(Bits == 4 || Bits == 8, "packed_depth_array: Bits must be 4 or 8");
+
+  static constexpr unsigned per_word = 64 / Bits;
+  static constexpr uint64_t mask = (uint64_t(1) << Bits) - 1;
+
+ public:
+
+  /**
+   * The largest depth that can be stored.
+   */
+  static constexpr unsigned max_depth = (1U << Bits) - 2;
+
+  /**
+   * Constructs an array where no rank is reached.
+   *
+   * @param rank_count the number of ranks
+   */
+  explicit packed_depth_array(uint64_t rank_count) :
+    rank_count_(rank_count),
+    words_((rank_count + per_word - 1) / per_word) {}
+
+  uint64_t rank_count() const {
+    return rank_count_;
+  }
+
+  /**
+   * Store the depth of a rank if it has none yet.
+   *
+   * Thread safe.
+   *
+   * @param rank  the rank to store the depth of
+   * @param depth the depth to store
+   * @return      whether the rank had no depth before
+   */
+  bool try_set(uint64_t rank, unsigned depth) {
+    if (depth > max_depth)
+      throw std::overflow_error("packed_depth_array: depth does not fit in Bits");
+    uint64_t &word = words_[rank / per_word];
+    unsigned shift = rank % per_word * Bits;
+    uint64_t old_word = __atomic_load_n(&word, __ATOMIC_RELAXED);
+    do {
+      if (old_word >> shift & mask)
+        return false;
+    } while (!__atomic_compare_exchange_n(
+        &word, &old_word, old_word | uint64_t(depth + 1) << shift,
+        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return true;
+  }
+
+  /**
+   * @param rank the rank to look up
+   * @return     its depth, or nothing if it is not reached
+   */
+  std::optional<unsigned> depth(uint64_t rank) const {
+    unsigned stored = field(words_.data(), rank);
+    if (!stored)
+      return std::nullopt;
+    return stored - 1;
+  }
+
+  /**
+   * Read the packed field of a rank, 0 if it is not
+   * reached and depth + 1 otherwise, from words in
+   * the layout of words(), like a mapped copy.
+   */
+  static unsigned field(const uint64_t *words, uint64_t rank) {
+    return words[rank / per_word] >> (rank % per_word * Bits) & mask;
+  }
+
+  /**
+   * The packed words, for writing the array out.
+   */
+  const std::vector<uint64_t> &words() const {
+    return words_;
+  }
+
+ private:
+
+  uint64_t rank_count_;
+  std::vector<uint64_t> words_;
+
+};
+
+/**
+ * The depth of every reached state of any hashable
+ * type, stored as a byte next to the state.
+ */
+template<class T, class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+class depth_map {
+ public:
+
+  /**
+   * The largest depth that can be stored.
+   */
+  static constexpr unsigned max_depth = 255;
+
+  /**
+   * Store the depth of a state if it has none yet.
+   *
+   * Thread safe.
+   *
+   * @param state the state to store the depth of
+   * @param depth the depth to store
+   * @return      whether the state had no depth before
+   */
+  bool try_set(const T &state, unsigned depth) {
+    if (depth > max_depth)
+      throw std::overflow_error("depth_map: depth does not fit in a byte");
+    return map_.try_emplace(state, uint8_t(depth)).second;
+  }
+
+  /**
+   * Thread safe.
+   *
+   * @param state the state to look up
+   * @return      its depth, or nothing if it is not reached
+   */
+  std::optional<unsigned> depth(const T &state) const {
+    std::optional<unsigned> res;
+    map_.if_contains(state, [&](const auto &entry) { res = entry.second; });
+    return res;
+  }
+
+  /**
+   * @return the number of reached states
+   */
+  size_t size() const {
+    return map_.size();
+  }
+
+ private:
+
+  phmap::parallel_flat_hash_map<T, uint8_t, Hash, KeyEqual,
+                                phmap::priv::Allocator<std::pair<const T, uint8_t>>,
+                                4UL, std::mutex>
+      map_;
+
+};
+
+/**
+ * Key function giving the state itself.
+ */
+struct identity_key {
+  template<class T>
+  const T &operator()(const T &state) const {
+    return state;
+  }
+};
+
+/**
+ * Visited set for bfs recording the depth of every new
+ * state in a depth_map or packed_depth_array, under the
+ * key that key gives for the state.
+ *
+ * The depth given to new states must be advanced to
+ * one more than each layer before it is expanded.
+ * New states deeper than Depths::max_depth are not
+ * recorded or visited, and set overflowed instead.
+ */
+template<class Depths, class Key = identity_key>
+struct depth_recorder {
+  Depths &depths;
+  Key key;
+  unsigned depth = 0;
+  std::atomic<bool> overflowed{false};
+
+  /**
+   * @brief holds a member
+   * boolean with the name
+   * second to allow drop in
+   * replacement for std::set
+   */
+  struct second_holder {
+    bool second;
+    operator bool() {
+      return second;
+    }
+  };
+
+  template<class T>
+  second_holder emplace(const T &state) {
+    if (depth > Depths::max_depth) {
+      // nothing gets recorded this deep, so only a state
+      // without a depth yet is lost, and not one that was
+      // reached again from the last layer
+      if (!depths.depth(key(state)))
+        overflowed.store(true, std::memory_order_relaxed);
+      return {false};
+    }
+    return {depths.try_set(key(state), depth)};
+  }
+};
@@ -4,10 +4,13 @@
 #include <chrono>
 #include <cstddef>
 #include <forward_list>
+#include <memory>
 #include <mutex>
 #include <utility>
 #include <vector>
 
+#include "splitmix64.hpp"
+
 /**
  * Hash set for use by multiple threads at once.
  *
@@ -15,14 +18,16 @@
  * so one should try and allocate an
  * appropriate amount beforehand.
  *
- * @tparam Key      The type to store in the set
- * @tparam Hash     Function-object type for hasing keys
- * @tparam KeyEqual Function-object type for checking key equality
+ * @tparam Key       The type to store in the set
+ * @tparam Hash      Function-object type for hasing keys
+ * @tparam KeyEqual  Function-object type for checking key equality
+ * @tparam Allocator Allocator used for the buckets and the keys
  */
 template<
  class Key,
  class Hash = std::hash<Key>,
- class KeyEqual = std::equal_to<Key>
+ class KeyEqual = std::equal_to<Key>,
+ class Allocator = std::allocator<Key>
 > class fixed_size_set {
  public:
 
@@ -34,17 +39,19 @@ template<
    *                  input hard to create
    * @param hash      Instance to use of the Hash function-object type
    * @param key_equal Instance to use of the KeyEqual function-object type
+   * @param alloc     Instance to use of the Allocator type
    */
   fixed_size_set(
       int bits,
       uint64_t seed = std::chrono::steady_clock::now().time_since_epoch().count(),
       const Hash &hash = Hash(),
-      const KeyEqual &key_equal = KeyEqual()) :
+      const KeyEqual &key_equal = KeyEqual(),
+      const Allocator &alloc = Allocator()) :
     fixed_random_(seed),
     hash_(hash),
     key_equal_(key_equal),
     bits_(bits),
-    buckets_(size_t(1)<<bits) {}
+    buckets_(size_t(1)<<bits, bucket_allocator(alloc)) {}
 
   /**
    * @brief holds a member
@@ -89,23 +96,14 @@ template<
   Hash hash_;
   KeyEqual key_equal_;
 
-  const int bits_;
-  std::vector<std::pair<std::mutex, std::forward_list<Key>>> buckets_;
+  using key_allocator =
+    typename std::allocator_traits<Allocator>::template rebind_alloc<Key>;
+  using bucket = std::pair<std::mutex, std::forward_list<Key, key_allocator>>;
+  using bucket_allocator =
+    typename std::allocator_traits<Allocator>::template rebind_alloc<bucket>;
 
-  /**
-   * @brief Post-hash used to to mitigate
-   * issues from a bad distribution from hash_
-   * 
-   * @param x hash value with a possibly bad distribution when truncated
-   * @return  a new hash with low-bits hopefully better distributed
-   */
-  static uint64_t splitmix64(uint64_t x) {
-    // http://xorshift.di.unimi.it/splitmix64.c
-    x += 0x9e3779b97f4a7c15;
-    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
-    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
-    return x ^ (x >> 31);
-  }
+  const int bits_;
+  std::vector<bucket, bucket_allocator> buckets_;
 
   /**
    * @brief maps a key to an index in [0, 2**bits)
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel_hashmap/phmap.h"
+#include "splitmix64.hpp"
+
+/**
+ * Parallel A* in the style of HDA*, for transitions
+ * of cost 1.
+ *
+ * Every state is owned by the thread its hash maps to,
+ * which alone keeps its best known cost in a local hash
+ * map and a local open list ordered by f = g + h, so
+ * neither needs a lock. Successors owned by other
+ * threads are sent in batches to their inboxes.
+ *
+ * Goals found update a shared incumbent cost, and nodes
+ * with f not below it are pruned. The search ends when
+ * the count of busy threads plus messages in flight
+ * reaches 0, after which no node with f below the
+ * incumbent exists, so with an admissible heuristic
+ * the incumbent is optimal.
+ *
+ * @param neighbors    function giving the states one step from a state
+ * @param heuristic    admissible estimate of the cost from a state to a goal
+ * @param is_goal      predicate telling which states are goals
+ * @param thread_count the number of threads to use
+ * @param batch_size   how many states to collect for a thread before sending
+ * @return             the cost of a cheapest path to a goal,
+ *                     or nothing if no goal is reachable
+ */
+template <class Neighbors, class Heuristic, class IsGoal, class T,
+          class Hash = std::hash<T>, class KeyEqual = std::equal_to<T>>
+std::optional<std::size_t> hda_star(Neighbors &&neighbors,
+                                    Heuristic &&heuristic, IsGoal &&is_goal,
+                                    const T &initial_state, int thread_count,
+                                    std::size_t batch_size = 64) {
+  constexpr std::size_t no_goal = std::numeric_limits<std::size_t>::max();
+
+  // flush every outbox after this many expansions, so
+  // a thread that never runs out of work still sends
+  constexpr std::size_t flush_interval = 256;
+
+  using message = std::pair<T, std::size_t>;
+
+  struct node {
+    std::size_t f;
+    std::size_t g;
+    T state;
+
+    // order for a max-heap that pops the lowest f,
+    // preferring deeper nodes among equal f
+    bool operator<(const node &r) const {
+      return f != r.f ? f > r.f : g < r.g;
+    }
+  };
+
+  struct alignas(64) inbox {
+    std::mutex mutex;
+    std::vector<message> messages;
+  };
+
+  Hash hash;
+  std::vector<inbox> inboxes(thread_count);
+  std::atomic<std::size_t> incumbent(no_goal);
+
+  // busy threads plus messages sent but not yet taken,
+  // every increment happening before its decrement
+  std::atomic<long> work(thread_count);
+
+  auto owner = [&](const T &state) {
+    return int(splitmix64(hash(state)) % thread_count);
+  };
+
+  inboxes[owner(initial_state)].messages.emplace_back(initial_state, 0);
+  ++work;
+
+  auto run = [&](int thread_id) {
+    phmap::flat_hash_map<T, std::size_t, Hash, KeyEqual> best;
+    std::priority_queue<node> open;
+    std::vector<std::vector<message>> outboxes(thread_count);
+    std::vector<message> received;
+    std::size_t expanded = 0;
+    bool busy = true;
+
+    auto insert = [&](const T &state, std::size_t g) {
+      auto [it, inserted] = best.try_emplace(state, g);
+      if (!inserted) {
+        if (it->second <= g)
+          return;
+        it->second = g;
+      }
+      if (is_goal(state)) {
+        std::size_t cost = incumbent.load();
+        while (g < cost && !incumbent.compare_exchange_weak(cost, g)) {}
+        return;
+      }
+      std::size_t f = g + heuristic(state);
+      if (f < incumbent.load(std::memory_order_relaxed))
+        open.push({f, g, state});
+    };
+
+    auto flush = [&](int to) {
+      auto &outbox = outboxes[to];
+      if (outbox.empty())
+        return;
+      work += outbox.size();
+      {
+        std::lock_guard<std::mutex> lock(inboxes[to].mutex);
+        auto &messages = inboxes[to].messages;
+        messages.insert(messages.end(), outbox.begin(), outbox.end());
+      }
+      outbox.clear();
+    };
+
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(inboxes[thread_id].mutex);
+        std::swap(received, inboxes[thread_id].messages);
+      }
+      if (!received.empty()) {
+        if (!busy) {
+          ++work;
+          busy = true;
+        }
+        for (auto &[state, g] : received)
+          insert(state, g);
+        work -= received.size();
+        received.clear();
+      }
+
+      // the incumbent may have improved since the nodes were
+      // pushed, and the lowest f is at the top, so either all
+      // of the open list is pruned or none of it
+      if (!open.empty() && open.top().f >= incumbent.load(std::memory_order_relaxed))
+        std::priority_queue<node>().swap(open);
+
+      if (open.empty()) {
+        for (int to = 0; to < thread_count; ++to)
+          flush(to);
+        if (busy) {
+          busy = false;
+          --work;
+        }
+        if (work.load() == 0)
+          return;
+        std::this_thread::yield();
+        continue;
+      }
+
+      node current = open.top();
+      open.pop();
+      if (best.find(current.state)->second < current.g)
+        continue;
+
+      for (const auto &next : neighbors(current.state)) {
+        std::size_t g = current.g + 1;
+        int to = owner(next);
+        if (to == thread_id) {
+          insert(next, g);
+        } else {
+          outboxes[to].emplace_back(next, g);
+          if (outboxes[to].size() >= batch_size)
+            flush(to);
+        }
+      }
+
+      if (++expanded % flush_interval == 0)
+        for (int to = 0; to < thread_count; ++to)
+          flush(to);
+    }
+  };
+
+  std::vector<std::thread> threads(thread_count);
+  for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+    threads[thread_id] = std::thread(run, thread_id);
+  for (auto &thread : threads) thread.join();
+
+  if (incumbent == no_goal)
+    return std::nullopt;
+  return incumbent.load();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+
+/**
+ * How huge_page_allocator gets its huge pages.
+ */
+enum class huge_pages {
+  /**
+   * Ask for transparent huge pages with madvise,
+   * which the kernel may or may not grant.
+   */
+  transparent,
+  /**
+   * Map explicit 2MB pages with MAP_HUGETLB, falling
+   * back to transparent huge pages if none are reserved
+   * (see /proc/sys/vm/nr_hugepages).
+   */
+  explicit_2mb,
+};
+
+/**
+ * Allocator backing large allocations with
+ * 2MB pages to reduce TLB misses.
+ *
+ * Allocations smaller than a huge page go through
+ * operator new as usual, since they would waste
+ * most of a huge page.
+ *
+ * Usable with standard containers, phmap and
+ * chunked_vector, and it is stateless so all
+ * instances compare equal.
+ *
+ * @tparam T    the type to allocate
+ * @tparam Mode how to get the huge pages
+ */
+template<class T, huge_pages Mode = huge_pages::transparent>
+struct huge_page_allocator {
+
+  using value_type = T;
+
+  template<class U>
+  struct rebind {
+    using other = huge_page_allocator<U, Mode>;
+  };
+
+  static constexpr size_t huge_page_size = size_t(2) << 20;
+
+  huge_page_allocator() = default;
+
+  template<class U>
+  huge_page_allocator(const huge_page_allocator<U, Mode>&) {}
+
+  T *allocate(size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (bytes < huge_page_size)
+      return static_cast<T*>(::operator new(bytes));
+
+    bytes = round_up(bytes);
+
+    if (Mode == huge_pages::explicit_2mb) {
+      void *mapping = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (mapping != MAP_FAILED)
+        return static_cast<T*>(mapping);
+    }
+
+    // over-allocate so the region can be trimmed
+    // to 2MB alignment, which THP requires
+    size_t padded = bytes + huge_page_size;
+    void *mapping = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+      throw std::bad_alloc();
+
+    auto begin = reinterpret_cast<uintptr_t>(mapping);
+    auto aligned = round_up(begin);
+    if (aligned != begin)
+      ::munmap(mapping, aligned - begin);
+    if (begin + padded != aligned + bytes)
+      ::munmap(reinterpret_cast<void*>(aligned + bytes), begin + padded - (aligned + bytes));
+
+    ::madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+    return reinterpret_cast<T*>(aligned);
+  }
+
+  void deallocate(T *p, size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (bytes < huge_page_size)
+      ::operator delete(p);
+    else
+      ::munmap(p, round_up(bytes));
+  }
+
+  template<class U>
+  friend bool operator==(const huge_page_allocator&, const huge_page_allocator<U, Mode>&) {
+    return true;
+  }
+
+  template<class U>
+  friend bool operator!=(const huge_page_allocator&, const huge_page_allocator<U, Mode>&) {
+    return false;
+  }
+
+ private:
+
+  static size_t round_up(size_t bytes) {
+    return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+  }
+
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel_hashmap/phmap.h"
+#include "splitmix64.hpp"
+
+/**
+ * Bounded table for use by multiple threads at once,
+ * remembering the lowest depth each state was reached
+ * at in the current iteration of a depth-first search.
+ *
+ * Every key hashes to a bucket of four entries. A key
+ * missing from its full bucket replaces an entry of an
+ * older iteration if there is one, and otherwise the
+ * entry with the largest depth, as states near the
+ * root prune the largest subtrees. Forgetting states
+ * only costs repeated work, never a wrong answer.
+ *
+ * @tparam Key      The type of the states, must be default constructible
+ * @tparam Hash     Function-object type for hasing keys
+ * @tparam KeyEqual Function-object type for checking key equality
+ */
+template<
+ class Key,
+ class Hash = std::hash<Key>,
+ class KeyEqual = std::equal_to<Key>
+> class transposition_table {
+ public:
+
+  /**
+   * Constructs an empty table. Throws std::invalid_argument
+   * if bits is not between 1 and 63.
+   *
+   * @param bits      Number of buckets will be 1<<bits,
+   *                  each holding 4 entries
+   * @param seed      Used in post-hash to make adversarial
+   *                  input hard to create
+   * @param hash      Instance to use of the Hash function-object type
+   * @param key_equal Instance to use of the KeyEqual function-object type
+   */
+  transposition_table(
+      int bits,
+      uint64_t seed = std::chrono::steady_clock::now().time_since_epoch().count(),
+      const Hash &hash = Hash(),
+      const KeyEqual &key_equal = KeyEqual()) :
+    fixed_random_(seed),
+    hash_(hash),
+    key_equal_(key_equal),
+    bits_(checked_bits(bits)),
+    entries_(size_t(slots_per_bucket) << bits_),
+    locks_(size_t(1) << std::min(bits_, max_lock_bits)) {}
+
+  /**
+   * Record that a state is reached at a depth, and
+   * tell whether it still has to be searched.
+   *
+   * @param key       The state reached
+   * @param depth     The depth it is reached at
+   * @param iteration The iteration of the search, starting at 1
+   * @return false if the state is known to be reached
+   *         at most as deep in the same iteration
+   */
+  bool visit(const Key &key, uint32_t depth, uint32_t iteration) {
+    size_t bucket = splitmix64(hash_(key) ^ fixed_random_) >> (64 - bits_);
+    std::lock_guard<std::mutex> lock(locks_[bucket & (locks_.size() - 1)]);
+
+    entry *first = &entries_[bucket * slots_per_bucket];
+    entry *victim = first;
+    for (entry *e = first; e != first + slots_per_bucket; ++e) {
+      if (e->iteration && key_equal_(e->key, key)) {
+        if (e->iteration == iteration && e->depth <= depth)
+          return false;
+        e->depth = depth;
+        e->iteration = iteration;
+        return true;
+      }
+      if (worse(*e, *victim, iteration))
+        victim = e;
+    }
+
+    victim->key = key;
+    victim->depth = depth;
+    victim->iteration = iteration;
+    return true;
+  }
+
+ private:
+
+  static constexpr int max_lock_bits = 16;
+  static constexpr int slots_per_bucket = 4;
+
+  struct entry {
+    Key key{};
+    uint32_t depth = 0;
+
+    // 0 while the entry is empty
+    uint32_t iteration = 0;
+  };
+
+  const uint64_t fixed_random_;
+  Hash hash_;
+  KeyEqual key_equal_;
+  int bits_;
+  std::vector<entry> entries_;
+  std::vector<std::mutex> locks_;
+
+  // the bucket is the top bits_ bits of a 64 bit hash
+  static int checked_bits(int bits) {
+    if (bits < 1 || bits > 63)
+      throw std::invalid_argument("transposition_table: bits must be between 1 and 63");
+    return bits;
+  }
+
+  /**
+   * Whether l is a better entry to replace than r.
+   */
+  static bool worse(const entry &l, const entry &r, uint32_t iteration) {
+    bool l_stale = l.iteration != iteration;
+    bool r_stale = r.iteration != iteration;
+    if (l_stale != r_stale)
+      return l_stale;
+    if (l_stale)
+      return l.iteration < r.iteration;
+    return l.depth > r.depth;
+  }
+
+};
+
+/**
+ * Parallel iterative deepening depth-first search
+ * for the shallowest goal, using memory bounded by
+ * the transposition table and the depth.
+ *
+ * A sequential bfs first expands the shallow layers
+ * until a layer has prefix_size states, and every
+ * iteration then searches depth-first below those
+ * states, with threads taking them one at a time.
+ * The transposition table prunes states reached
+ * again at no lower depth in the same iteration.
+ *
+ * @param neighbors    function giving the states one step from a state
+ * @param is_goal      predicate telling which states are goals
+ * @param thread_count the number of threads to use
+ * @param table_bits   the transposition table has 4<<table_bits entries
+ * @param max_depth    the deepest to look for a goal
+ * @param prefix_size  how many states to split between the threads
+ * @return             the depth of a shallowest goal,
+ *                     or nothing if none is at most max_depth deep
+ */
+template <class Neighbors, class IsGoal, class T, class Hash = std::hash<T>,
+          class KeyEqual = std::equal_to<T>>
+std::optional<std::size_t> iddfs(Neighbors &&neighbors, IsGoal &&is_goal,
+                                 const T &initial_state, int thread_count,
+                                 int table_bits, std::size_t max_depth,
+                                 std::size_t prefix_size = 1 << 10) {
+  std::vector<T> layer{initial_state};
+  std::size_t prefix_depth = 0;
+  {
+    phmap::flat_hash_set<T, Hash, KeyEqual> vis{initial_state};
+    for (;;) {
+      for (const auto &state : layer)
+        if (is_goal(state))
+          return prefix_depth;
+      if (layer.empty() || layer.size() >= prefix_size || prefix_depth == max_depth)
+        break;
+      std::vector<T> next_layer;
+      for (const auto &state : layer)
+        for (auto next : neighbors(state))
+          if (vis.emplace(next).second) next_layer.push_back(next);
+      std::swap(layer, next_layer);
+      ++prefix_depth;
+    }
+  }
+  if (layer.empty())
+    return std::nullopt;
+
+  transposition_table<T, Hash, KeyEqual> table(table_bits);
+  std::vector<std::thread> threads(thread_count);
+  std::atomic<std::size_t> next_root;
+  std::atomic<bool> found;
+  std::atomic<bool> cut_off;
+  std::size_t bound;
+  uint32_t iteration = 0;
+
+  auto search = [&](int) {
+    std::vector<std::pair<T, std::size_t>> stack;
+    for (;;) {
+      std::size_t root = next_root++;
+      if (root >= layer.size() || found.load(std::memory_order_relaxed))
+        return;
+      stack.emplace_back(layer[root], prefix_depth);
+      while (!stack.empty() && !found.load(std::memory_order_relaxed)) {
+        auto [state, depth] = std::move(stack.back());
+        stack.pop_back();
+        for (auto next : neighbors(state)) {
+          if (depth + 1 == bound) {
+            // goals shallower than bound were ruled out
+            // by the earlier iterations
+            if (is_goal(next))
+              found = true;
+            cut_off.store(true, std::memory_order_relaxed);
+          } else if (table.visit(next, depth + 1, iteration)) {
+            stack.emplace_back(std::move(next), depth + 1);
+          }
+        }
+      }
+      stack.clear();
+    }
+  };
+
+  for (bound = prefix_depth + 1; bound <= max_depth; ++bound) {
+    next_root = 0;
+    found = false;
+    cut_off = false;
+    ++iteration;
+
+    for (const auto &state : layer)
+      table.visit(state, prefix_depth, iteration);
+
+    for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+      threads[thread_id] = std::thread(search, thread_id);
+    for (auto &thread : threads) thread.join();
+
+    if (found)
+      return bound;
+
+    // nothing was deep enough to reach the bound,
+    // so the whole space has been searched
+    if (!cut_off)
+      return std::nullopt;
+  }
+
+  return std::nullopt;
+}
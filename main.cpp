@@ -1,12 +1,21 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <ios>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <random>
+#include <utility>
 
 #include "bfs.hpp"
+#include "delta_stepping.hpp"
+#include "hda_star.hpp"
+#include "huge_page_allocator.hpp"
+#include "iddfs.hpp"
+#include "pattern_database.hpp"
 #include "time.hpp"
 
 unsigned max_len;
@@ -28,6 +37,10 @@ struct S {
     return l.a == r.a;
   }
 
+  friend bool operator<(const S &l, const S &r) {
+    return l.a < r.a;
+  }
+
 };
 
 std::vector<S> cheap_sparse(const S &s) {
@@ -58,6 +71,35 @@ std::vector<S> cheap_sparse(const S &s) {
   return transitions;
 }
 
+/**
+ * The states that have s among their cheap_sparse transitions.
+ */
+std::vector<S> cheap_sparse_predecessors(const S &s) {
+  std::vector<S> transitions;
+
+  if (s.a.size() > 0) {
+    transitions.push_back(s);
+    transitions.back().a.pop_back();
+  }
+
+  if (s.a.size() < max_len) {
+    transitions.push_back(s);
+    transitions.back().a.push_back(0);
+    transitions.push_back(s);
+    transitions.back().a.push_back(1);
+  }
+
+  if (s.a.size() >= 2) {
+    for (int bit : {0, 1}) {
+      transitions.push_back(s);
+      transitions.back().a.pop_back();
+      transitions.back().a.back() = bit;
+    }
+  }
+
+  return transitions;
+}
+
 std::vector<S> cheap_dense(const S &s) {
   std::vector<S> transitions;
   if (s.a.size() < max_len) {
@@ -81,6 +123,100 @@ std::vector<S> cheap_dense(const S &s) {
   return transitions;
 }
 
+/**
+ * The states that have s among their cheap_dense transitions.
+ */
+std::vector<S> cheap_dense_predecessors(const S &s) {
+  std::vector<S> transitions;
+  if (s.a.size() > 0 && s.a.back() == 0) {
+    transitions.push_back(s);
+    transitions.back().a.pop_back();
+  }
+
+  unsigned as_bits = 0;
+  for (int i : s.a)
+    as_bits = as_bits << 1U | i;
+
+  for (unsigned deactivate = as_bits; deactivate != 0; deactivate = (deactivate-1) & as_bits) {
+    transitions.push_back(s);
+    auto &a = transitions.back().a;
+    for (int i = 0; i < (int)a.size(); ++i)
+      a[i] ^= deactivate >> (a.size() - i - 1) & 1;
+  }
+
+  return transitions;
+}
+
+/**
+ * cheap_sparse where every transition costs 1,
+ * to compare delta_stepping with bfs.
+ */
+std::vector<std::pair<S, uint64_t>> cheap_sparse_unit(const S &s) {
+  std::vector<std::pair<S, uint64_t>> transitions;
+  for (auto &next : cheap_sparse(s))
+    transitions.emplace_back(std::move(next), 1);
+  return transitions;
+}
+
+/**
+ * cheap_sparse where a transition costs 2
+ * if it ends with a 1 bit, and 1 otherwise.
+ */
+std::vector<std::pair<S, uint64_t>> cheap_sparse_weighted(const S &s) {
+  std::vector<std::pair<S, uint64_t>> transitions;
+  for (auto &next : cheap_sparse(s)) {
+    uint64_t cost = 1 + (!next.a.empty() && next.a.back());
+    transitions.emplace_back(std::move(next), cost);
+  }
+  return transitions;
+}
+
+/**
+ * cheap_sparse_unit, but the transitions out of the empty
+ * state cost 1 << 30, far more buckets than delta_stepping
+ * keeps in its rings.
+ */
+std::vector<std::pair<S, uint64_t>> cheap_sparse_far(const S &s) {
+  auto transitions = cheap_sparse_unit(s);
+  if (s.a.empty())
+    for (auto &transition : transitions)
+      transition.second = uint64_t(1) << 30;
+  return transitions;
+}
+
+/**
+ * cheap_sparse where transitions that shorten
+ * the state are free, and others cost 1.
+ */
+std::vector<std::pair<S, int>> cheap_sparse_zero_one(const S &s) {
+  std::vector<std::pair<S, int>> transitions;
+  for (auto &next : cheap_sparse(s)) {
+    int cost = next.a.size() >= s.a.size();
+    transitions.emplace_back(std::move(next), cost);
+  }
+  return transitions;
+}
+
+/**
+ * Representative of s and its complement, the one
+ * starting with a 0 bit, as cheap_sparse commutes
+ * with complementing every bit.
+ */
+S complement_canonical(const S &s) {
+  S res = s;
+  if (!res.a.empty() && res.a[0])
+    for (int &bit : res.a) bit ^= 1;
+  return res;
+}
+
+/**
+ * The size of the class of s under complementing,
+ * which only leaves the empty state alone.
+ */
+uint64_t complement_orbit_size(const S &s) {
+  return s.a.empty() ? 1 : 2;
+}
+
 auto expensive_sparse(const S &s) {
   auto transitions = cheap_sparse(s);
 
@@ -91,6 +227,121 @@ auto expensive_sparse(const S &s) {
   return transitions;
 }
 
+/**
+ * An S encoded by S_codec, read in place:
+ * its bits, one byte each, and their count.
+ */
+struct S_view {
+  const char *bits;
+  size_t size;
+};
+
+/**
+ * cheap_sparse reading the state through an S_view,
+ * so it is never decoded into an S of its own.
+ */
+std::vector<S> cheap_sparse_view(const S_view &s) {
+  std::vector<S> transitions;
+
+  // a new transition starting with the first prefix_len bits of s
+  auto transition = [&](size_t prefix_len) -> std::vector<int>& {
+    auto &a = transitions.emplace_back().a;
+    a.reserve(prefix_len + 2);
+    a.assign(s.bits, s.bits + prefix_len);
+    return a;
+  };
+
+  if (s.size < max_len) {
+    transition(s.size).push_back(0);
+    transition(s.size).push_back(1);
+  }
+
+  if (s.size > 0) {
+    transition(s.size - 1);
+
+    if (s.size < max_len) {
+      for (int bit0 : {0, 1})
+        for (int bit1 : {0, 1}) {
+          auto &a = transition(s.size - 1);
+          a.push_back(bit0);
+          a.push_back(bit1);
+        }
+    }
+  }
+
+  return transitions;
+}
+
+/**
+ * Stores an S as its length followed by one byte per bit.
+ */
+struct S_codec {
+  using view_type = S_view;
+
+  void encode(const S &s, std::vector<char> &out) const {
+    out.push_back(char(s.a.size()));
+    for (int bit : s.a) out.push_back(char(bit));
+  }
+
+  const char *decode(const char *in, S &s) const {
+    auto len = (unsigned char)*in++;
+    s.a.assign(in, in + len);
+    return in + len;
+  }
+
+  view_type view(const char *bytes, size_t size) const {
+    return {bytes + 1, size - 1};
+  }
+};
+
+/**
+ * Ranks an S as its bits below a leading 1 bit, minus one,
+ * so every rank below 2 << max_len is the rank of an S.
+ */
+struct S_rank {
+  uint64_t operator()(const S &s) const {
+    uint64_t res = 1;
+    for (int bit : s.a) res = res << 1 | bit;
+    return res - 1;
+  }
+};
+
+struct S_unrank {
+  S operator()(uint64_t rank) const {
+    S s;
+    ++rank;
+    for (int i = 62 - __builtin_clzll(rank); i >= 0; --i)
+      s.a.push_back(rank >> i & 1);
+    return s;
+  }
+};
+
+/**
+ * cheap_sparse over the S_rank ranks of the states,
+ * for engines that need trivially copyable states,
+ * computed on the ranks without building an S.
+ */
+std::vector<uint64_t> cheap_sparse_ranks(uint64_t rank) {
+  std::vector<uint64_t> transitions;
+  uint64_t bits = rank + 1;
+  unsigned len = 63 - __builtin_clzll(bits);
+
+  if (len < max_len) {
+    transitions.push_back(2 * bits - 1);
+    transitions.push_back(2 * bits);
+  }
+
+  if (len > 0) {
+    transitions.push_back((bits >> 1) - 1);
+
+    if (len < max_len)
+      for (uint64_t low : {0, 1, 2, 3})
+        transitions.push_back((bits >> 1 << 2 | low) - 1);
+  }
+
+  return transitions;
+}
+
 namespace std {
 
 /**
@@ -129,6 +380,82 @@ int main() {
   TIME(bfs_fixed_size_set(cheap_sparse, S{}, 4, max_len));
   TIME(bfs_fixed_size_set(cheap_sparse, S{}, 2, max_len));
   TIME(bfs_fixed_size_set(cheap_sparse, S{}, 1, max_len));
+  TIME(bfs_phmap(cheap_sparse, S{}, 8, huge_page_allocator<S>()));
+  TIME(bfs_phmap(cheap_sparse, S{}, 8, huge_page_allocator<S, huge_pages::explicit_2mb>()));
+  TIME(bfs_fixed_size_set(cheap_sparse, S{}, 8, max_len, huge_page_allocator<S>()));
+  TIME(bfs_fixed_size_set(cheap_sparse, S{}, 8, max_len, huge_page_allocator<S, huge_pages::explicit_2mb>()));
+  TIME(bfs_mmap_set(cheap_sparse_ranks, S_rank()(S{}), 8, "/tmp", 13));
+  shm_set<uint64_t>::unlink("/bfs_bench_vis");
+  TIME(bfs_shm_set(cheap_sparse_ranks, S_rank()(S{}), 8, "/bfs_bench_vis", 22));
+  shm_set<uint64_t>::unlink("/bfs_bench_vis");
+  TIME(bfs_cuckoo_filter(cheap_sparse_ranks, S_rank()(S{}), 8, 20, 2, max_len));
+  TIME(bfs_delayed_dedup(cheap_sparse, S{}, 8));
+  TIME(bfs_frontier_search(cheap_sparse, S{}, 8, true));
+  TIME(bfs_phmap_spilled(cheap_sparse, S{}, 8, "/tmp", S_codec()));
+  TIME(bfs_phmap_arena(cheap_sparse_view, S{}, 8, S_codec()));
+  TIME(bfs_phmap_compressed(cheap_sparse, S{}, 8, S_rank(), S_unrank()));
+  TIME(bfs_phmap_bidirectional(cheap_sparse, cheap_sparse_predecessors, S{},
+                               S{std::vector<int>(max_len, 1)}, 8));
+  TIME(hda_star(cheap_sparse,
+                [](const S &s) { return max_len - s.a.size(); },
+                [](const S &s) { return s.a == std::vector<int>(max_len, 1); },
+                S{}, 8));
+  TIME(bfs_depth_map(cheap_sparse, S{}, 8));
+  {
+    phmap::parallel_flat_hash_set<S, std::hash<S>, std::equal_to<S>,
+                                  std::allocator<S>, 4UL, std::mutex>
+        vis;
+    S goal{std::vector<int>(max_len, 1)};
+    std::optional<std::vector<S>> path;
+    TIME(path = bfs_path(cheap_sparse, S{}, 8, vis,
+                         [&](const S &s) { return s == goal; }));
+    // a shortest path has one more state than the goal is deep
+    auto depths = bfs_depth_map(cheap_sparse, S{}, 8);
+    std::cout << "bfs_path(cheap_sparse, S{}, 8): " << path->size() - 1
+              << " steps, bfs_depths: " << *depths.depth(goal) << std::endl;
+  }
+  TIME(delta_stepping(cheap_sparse_unit, S{}, 8));
+  TIME(delta_stepping(cheap_sparse_weighted, S{}, 8));
+  TIME(delta_stepping(cheap_sparse_weighted, S{}, 8, 2));
+  {
+    auto dist = delta_stepping(cheap_sparse_far, S{}, 8);
+    // the farthest states are max_len - 1 steps past a 1 << 30 one
+    uint64_t farthest = 0;
+    for (const auto &[state, distance] : dist)
+      farthest = std::max(farthest, distance);
+    std::cout << "delta_stepping(cheap_sparse_far, S{}, 8): farthest "
+              << farthest << ", expected " << (uint64_t(1) << 30) + max_len - 1
+              << std::endl;
+  }
+  TIME(bfs_phmap_zero_one(cheap_sparse_zero_one, S{}, 8));
+  TIME(iddfs(cheap_sparse,
+             [](const S &s) { return s.a == std::vector<int>(12, 1); },
+             S{}, 8, 16, max_len));
+  symmetry_stats stats;
+  TIME(bfs_phmap_symmetric(cheap_sparse, complement_canonical, S{}, 8, stats,
+                           complement_orbit_size));
+  std::cout << stats.representatives << " representatives of "
+            << stats.represented << " states, " << stats.replaced() << " of "
+            << stats.successors() << " successors replaced" << std::endl;
+  TIME(bfs_depth_array<8>(cheap_sparse, S{}, 8, S_rank(), (uint64_t(2) << max_len) - 1));
+  TIME(pattern_database<8>(cheap_sparse_predecessors, std::vector<S>{S{}}, 8,
+                           S_rank(), (uint64_t(2) << max_len) - 1));
+  std::cout << std::endl;
+  // */
+
+  //*
+  // the longest states are exactly packed_depth_array<4>::max_depth deep
+  set_max_len(packed_depth_array<4>::max_depth);
+  TIME(bfs_depth_array<4>(cheap_sparse, S{}, 8, S_rank(), (uint64_t(2) << max_len) - 1));
+  TIME(pattern_database<4>(cheap_sparse_predecessors, std::vector<S>{S{}}, 8,
+                           S_rank(), (uint64_t(2) << max_len) - 1));
+  std::cout << std::endl;
+  // */
+
+  //*
+  set_max_len(24);
+  TIME(bfs_phmap(cheap_sparse_ranks, S_rank()(S{}), 8));
+  TIME(bfs_phmap_reordered(cheap_sparse_ranks, S_rank()(S{}), 8));
   std::cout << std::endl;
   // */
 
@@ -149,6 +476,10 @@ int main() {
   TIME(bfs_fixed_size_set(cheap_dense, S{}, 4, max_len));
   TIME(bfs_fixed_size_set(cheap_dense, S{}, 2, max_len));
   TIME(bfs_fixed_size_set(cheap_dense, S{}, 1, max_len));
+  TIME(bfs_phmap(cheap_dense, S{}, 8));
+  TIME(bfs_bitmap(cheap_dense, S{}, 8, S_rank(), S_unrank(), (uint64_t(2) << max_len) - 1));
+  TIME(bfs_direction_optimizing(cheap_dense, cheap_dense_predecessors, S{}, 8,
+                                S_rank(), S_unrank(), (uint64_t(2) << max_len) - 1));
   std::cout << std::endl;
   // */
 
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "splitmix64.hpp"
+
+/**
+ * Hash set for use by multiple threads at once,
+ * stored in a memory-mapped file instead of RAM.
+ *
+ * The file is split into fixed-size pages, and
+ * each key hashes to a home page where it is
+ * placed with linear probing. Only when the home
+ * page is full does a key spill into the next page,
+ * so a lookup usually touches a single page, and
+ * the kernel can keep the hot pages resident and
+ * write the rest back to disk.
+ *
+ * The file gets a fresh name in the given directory
+ * and is unlinked as soon as it is created, so no
+ * existing file is touched and it disappears when
+ * the set is destroyed.
+ *
+ * @tparam Key      The type to store in the set, must be trivially copyable
+ * @tparam Hash     Function-object type for hasing keys
+ * @tparam KeyEqual Function-object type for checking key equality
+ */
+template<
+ class Key,
+ class Hash = std::hash<Key>,
+ class KeyEqual = std::equal_to<Key>
+> class mmap_set {
+  static_assert(std::is_trivially_copyable<Key>::value,
+                "mmap_set stores keys as raw bytes in a file");
+
+ public:
+
+  /**
+   * Constructs the set and its backing file.
+   *
+   * @param directory Where to create the backing file,
+   *                  preferably on a local NVMe drive
+   * @param page_bits Number of pages will be 1<<page_bits
+   * @param page_size Size of a page in bytes, should be
+   *                  a multiple of the OS page size
+   * @param seed      Used in post-hash to make adversarial
+   *                  input hard to create
+   * @param hash      Instance to use of the Hash function-object type
+   * @param key_equal Instance to use of the KeyEqual function-object type
+   */
+  mmap_set(
+      const std::string &directory,
+      int page_bits,
+      size_t page_size = 4096,
+      uint64_t seed = std::chrono::steady_clock::now().time_since_epoch().count(),
+      const Hash &hash = Hash(),
+      const KeyEqual &key_equal = KeyEqual()) :
+    fixed_random_(seed),
+    hash_(hash),
+    key_equal_(key_equal),
+    page_bits_(page_bits),
+    page_size_(page_size),
+    slots_per_page_(slots_fitting(page_size)),
+    keys_offset_(keys_offset(slots_per_page_)),
+    locks_(size_t(1) << std::min(page_bits, max_lock_bits)),
+    size_(0) {
+    if (slots_per_page_ == 0)
+      throw std::invalid_argument("mmap_set: page_size too small for a key");
+
+    file_size_ = page_size_ << page_bits_;
+
+    std::string path = directory + "/mmap_set_XXXXXX";
+    fd_ = ::mkstemp(&path[0]);
+    if (fd_ < 0)
+      throw std::system_error(errno, std::generic_category(), "mmap_set: mkstemp " + path);
+    ::unlink(path.c_str());
+
+    // the file is sparse, so pages read back as
+    // zeros (empty) until they are first written
+    if (::ftruncate(fd_, file_size_) != 0) {
+      int err = errno;
+      ::close(fd_);
+      throw std::system_error(err, std::generic_category(), "mmap_set: ftruncate");
+    }
+
+    void *mapping = ::mmap(nullptr, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+      int err = errno;
+      ::close(fd_);
+      throw std::system_error(err, std::generic_category(), "mmap_set: mmap");
+    }
+    data_ = static_cast<unsigned char*>(mapping);
+
+    // accesses are scattered by the hash,
+    // so read-ahead would only waste I/O
+    ::madvise(data_, file_size_, MADV_RANDOM);
+  }
+
+  mmap_set(const mmap_set&) = delete;
+  mmap_set &operator=(const mmap_set&) = delete;
+
+  ~mmap_set() {
+    ::munmap(data_, file_size_);
+    ::close(fd_);
+  }
+
+  /**
+   * @brief holds a member
+   * boolean with the name
+   * second to allow drop in
+   * replacement for std::set
+   */
+  struct second_holder {
+    bool second;
+    operator bool() {
+      return second;
+    }
+  };
+
+  /**
+   * Insert a key in a set if it is not there,
+   * and return whether it was already there.
+   *
+   * @param  key The key to insert
+   * @return true if the element was inserted,
+   *         and false if it was already there.
+   */
+  second_holder emplace(const Key &key) {
+    uint64_t hash = get_hash(key);
+    size_t page = get_page(hash);
+    for (size_t tried = 0; tried < page_count(); ++tried) {
+      std::lock_guard<std::mutex> lock(page_lock(page));
+      switch (insert_in_page(page, hash, key)) {
+        case insert_result::inserted: return {true};
+        case insert_result::found: return {false};
+        case insert_result::page_full: break;
+      }
+      page = (page + 1) & (page_count() - 1);
+    }
+    throw std::length_error("mmap_set: all pages are full");
+  }
+
+  /**
+   * Insert many keys, and output those that
+   * were not already in the set.
+   *
+   * The keys are grouped by their home page first,
+   * so each page is locked and faulted in only once
+   * per batch, and the pages are visited in file order.
+   *
+   * @param first    Iterator to the first key to insert
+   * @param last     Iterator past the last key to insert
+   * @param inserted Output iterator receiving the keys that were inserted
+   * @return         The output iterator after the last written key
+   */
+  template<class InputIt, class OutputIt>
+  OutputIt emplace_batch(InputIt first, InputIt last, OutputIt inserted) {
+    std::vector<std::pair<uint64_t, Key>> batch;
+    for (; first != last; ++first)
+      batch.emplace_back(get_hash(*first), *first);
+
+    std::sort(batch.begin(), batch.end(), [&](const auto &l, const auto &r) {
+      return get_page(l.first) < get_page(r.first);
+    });
+
+    for (size_t i = 0; i < batch.size();) {
+      size_t page = get_page(batch[i].first);
+      size_t j = i;
+      std::vector<size_t> overflowing;
+      {
+        std::lock_guard<std::mutex> lock(page_lock(page));
+        for (; j < batch.size() && get_page(batch[j].first) == page; ++j) {
+          switch (insert_in_page(page, batch[j].first, batch[j].second)) {
+            case insert_result::inserted: *inserted++ = batch[j].second; break;
+            case insert_result::found: break;
+            case insert_result::page_full: overflowing.push_back(j); break;
+          }
+        }
+      }
+      for (size_t k : overflowing)
+        if (emplace(batch[k].second))
+          *inserted++ = batch[k].second;
+      i = j;
+    }
+
+    return inserted;
+  }
+
+  /**
+   * Find the number of elements.
+   *
+   * @return the number of keys inserted so far
+   */
+  size_t size() const {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+
+  static constexpr int max_lock_bits = 16;
+
+  enum class insert_result { inserted, found, page_full };
+
+  /**
+   * @brief the header at the start of every page,
+   * followed by an occupancy bitmap and the keys
+   */
+  struct page_header {
+    uint64_t used;
+  };
+
+  const uint64_t fixed_random_;
+  Hash hash_;
+  KeyEqual key_equal_;
+
+  const int page_bits_;
+  const size_t page_size_;
+  const size_t slots_per_page_;
+  const size_t keys_offset_;
+  std::vector<std::mutex> locks_;
+  std::atomic<size_t> size_;
+
+  int fd_;
+  size_t file_size_;
+  unsigned char *data_;
+
+  static size_t bitmap_words(size_t slots) {
+    return (slots + 63) / 64;
+  }
+
+  /**
+   * @brief finds the byte offset of the keys within a page
+   */
+  static size_t keys_offset(size_t slots) {
+    size_t offset = sizeof(page_header) + bitmap_words(slots) * sizeof(uint64_t);
+    return (offset + alignof(Key) - 1) / alignof(Key) * alignof(Key);
+  }
+
+  /**
+   * @brief finds how many keys fit in a page
+   * together with the header and the bitmap
+   */
+  static size_t slots_fitting(size_t page_size) {
+    size_t slots = page_size / sizeof(Key);
+    while (slots > 0 && keys_offset(slots) + slots * sizeof(Key) > page_size)
+      --slots;
+    return slots;
+  }
+
+  size_t page_count() const {
+    return size_t(1) << page_bits_;
+  }
+
+  uint64_t get_hash(const Key &key) const {
+    return splitmix64(hash_(key) + fixed_random_);
+  }
+
+  /**
+   * @brief maps a hash to a home page, using the high
+   * bits so that the low bits are left for the slot
+   */
+  size_t get_page(uint64_t hash) const {
+    return page_bits_ == 0 ? 0 : hash >> (64 - page_bits_);
+  }
+
+  std::mutex &page_lock(size_t page) {
+    return locks_[page & (locks_.size() - 1)];
+  }
+
+  /**
+   * @brief inserts a key in a single page,
+   * the caller must hold the lock of the page
+   */
+  insert_result insert_in_page(size_t page, uint64_t hash, const Key &key) {
+    unsigned char *base = data_ + page * page_size_;
+    auto *header = reinterpret_cast<page_header*>(base);
+    auto *bitmap = reinterpret_cast<uint64_t*>(base + sizeof(page_header));
+    unsigned char *keys = base + keys_offset_;
+
+    size_t slot = hash % slots_per_page_;
+    for (size_t probed = 0; probed < slots_per_page_; ++probed) {
+      uint64_t bit = uint64_t(1) << (slot % 64);
+      if (!(bitmap[slot / 64] & bit)) {
+        std::memcpy(keys + slot * sizeof(Key), &key, sizeof(Key));
+        bitmap[slot / 64] |= bit;
+        ++header->used;
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return insert_result::inserted;
+      }
+
+      Key in_slot;
+      std::memcpy(&in_slot, keys + slot * sizeof(Key), sizeof(Key));
+      if (key_equal_(in_slot, key))
+        return insert_result::found;
+
+      if (++slot == slots_per_page_)
+        slot = 0;
+    }
+    return insert_result::page_full;
+  }
+
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "chunked_vector.hpp"
+
+/**
+ * Every layer of a search, with each state stored
+ * next to the index of its parent in the previous
+ * layer, so a path back to the initial state can be
+ * walked in O(depth) without storing parent states.
+ *
+ * @tparam T     the type of the states
+ * @tparam Index the type of the parent indices,
+ *               which must fit the largest layer
+ */
+template<class T, class Index = uint32_t>
+class parent_layers {
+ public:
+
+  /**
+   * A state and the index of its parent.
+   */
+  using entry = std::pair<T, Index>;
+  using layer_type = chunked_vector<entry>;
+
+  /**
+   * Constructs an empty list of layers.
+   *
+   * @param chunk_cnt the number of chunks of every layer
+   */
+  explicit parent_layers(size_t chunk_cnt) :
+    chunk_cnt_(chunk_cnt) {}
+
+  /**
+   * Add an empty layer, which is one deeper than the
+   * last. References to earlier layers stay valid.
+   *
+   * @return a reference to the new layer
+   */
+  layer_type &push_layer() {
+    layers_.emplace_back(chunk_cnt_);
+    return layers_.back();
+  }
+
+  layer_type &layer(size_t depth) {
+    return layers_[depth];
+  }
+
+  const layer_type &layer(size_t depth) const {
+    return layers_[depth];
+  }
+
+  /**
+   * @return the number of layers
+   */
+  size_t depth_count() const {
+    return layers_.size();
+  }
+
+  /**
+   * Walk the parent indices back to layer 0.
+   *
+   * Every layer up to depth must be sealed.
+   *
+   * @param depth the layer of the last state
+   * @param index the index of the last state in its layer
+   * @return      the states from layer 0 to the last state
+   */
+  std::vector<T> path_to(size_t depth, size_t index) const {
+    std::vector<T> path;
+    path.reserve(depth + 1);
+    for (size_t d = depth + 1; d-- > 0;) {
+      const entry &e = layers_[d].begin()[index];
+      path.push_back(e.first);
+      index = e.second;
+    }
+    return std::vector<T>(path.rbegin(), path.rend());
+  }
+
+ private:
+
+  size_t chunk_cnt_;
+  std::deque<layer_type> layers_;
+
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bfs.hpp"
+#include "depth_map.hpp"
+
+/**
+ * Pattern database: the distance to the nearest goal
+ * of every rank of an abstract state space, packed
+ * into Bits bits per rank.
+ *
+ * It is either built by a parallel backward bfs from
+ * the goals, or loaded from a file written by write(),
+ * which is memory-mapped so that solvers start at once
+ * and processes share the pages.
+ *
+ * @tparam Bits bits per rank, 4 or 8
+ */
+template<int Bits = 4>
+class pattern_database {
+
+  struct header {
+    uint64_t magic;
+    uint64_t bits;
+    uint64_t rank_count;
+    uint64_t word_count;
+  };
+
+  static constexpr uint64_t file_magic = 0x3162647474617000ULL | Bits;
+
+ public:
+
+  /**
+   * The distance of ranks that reach no goal.
+   */
+  static constexpr unsigned unreachable = (1U << Bits) - 1;
+
+  /**
+   * Builds the database by a bfs from the goals over
+   * predecessors, so depths are distances to a goal.
+   *
+   * Throws std::overflow_error if a distance is larger
+   * than packed_depth_array<Bits>::max_depth.
+   *
+   * @param predecessors function giving the states that
+   *                     have a state as a neighbor
+   * @param goals        the states at distance 0
+   * @param thread_count the number of threads to use
+   * @param rank         function mapping a state to its rank
+   * @param rank_count   the number of ranks
+   */
+  template<class Predecessors, class T, class Rank>
+  pattern_database(Predecessors &&predecessors, const std::vector<T> &goals,
+                   int thread_count, Rank rank, uint64_t rank_count) :
+    built_(std::make_unique<packed_depth_array<Bits>>(rank_count)),
+    rank_count_(rank_count) {
+    bfs_depths(std::forward<Predecessors>(predecessors), goals, thread_count,
+               *built_, std::move(rank));
+    words_ = built_->words().data();
+  }
+
+  /**
+   * Loads a database written by write(), mapping
+   * the file read-only instead of reading it.
+   *
+   * @param path the file to load
+   */
+  explicit pattern_database(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), "pattern_database: open " + path);
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "pattern_database: fstat");
+    }
+    mapping_size_ = info.st_size;
+    if (mapping_size_ < sizeof(header)) {
+      ::close(fd);
+      throw std::runtime_error("pattern_database: " + path + " is too small");
+    }
+
+    void *mapping = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+      throw std::system_error(err, std::generic_category(), "pattern_database: mmap");
+    mapping_ = mapping;
+
+    const header &head = *static_cast<const header*>(mapping_);
+    if (head.magic != file_magic || head.bits != Bits
+        || mapping_size_ != sizeof(header) + head.word_count * sizeof(uint64_t)) {
+      ::munmap(mapping_, mapping_size_);
+      throw std::runtime_error("pattern_database: " + path + " is not a "
+                               + std::to_string(Bits) + " bit database");
+    }
+
+    rank_count_ = head.rank_count;
+    words_ = reinterpret_cast<const uint64_t*>(static_cast<const char*>(mapping_) + sizeof(header));
+  }
+
+  pattern_database(const pattern_database&) = delete;
+  pattern_database &operator=(const pattern_database&) = delete;
+
+  pattern_database(pattern_database &&other) noexcept :
+    built_(std::move(other.built_)),
+    mapping_(std::exchange(other.mapping_, nullptr)),
+    mapping_size_(other.mapping_size_),
+    rank_count_(other.rank_count_),
+    words_(other.words_) {}
+
+  ~pattern_database() {
+    if (mapping_)
+      ::munmap(mapping_, mapping_size_);
+  }
+
+  uint64_t rank_count() const {
+    return rank_count_;
+  }
+
+  /**
+   * Thread safe due to not mutating anything.
+   *
+   * @param rank the rank to look up
+   * @return     its distance to the nearest goal,
+   *             or unreachable if there is none
+   */
+  unsigned operator[](uint64_t rank) const {
+    // 0 (not reached) wraps around to unreachable
+    return (packed_depth_array<Bits>::field(words_, rank) + unreachable) & unreachable;
+  }
+
+  /**
+   * Write the database to a file that the loading
+   * constructor can map.
+   *
+   * @param path the file to create or overwrite
+   */
+  void write(const std::string &path) const {
+    size_t word_count = (rank_count_ * Bits + 63) / 64;
+    header head{file_magic, Bits, rank_count_, word_count};
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), "pattern_database: open " + path);
+
+    auto write_all = [&](const void *data, size_t size) {
+      size_t written = 0;
+      while (written < size) {
+        ssize_t res = ::write(fd, static_cast<const char*>(data) + written, size - written);
+        if (res < 0 && errno != EINTR) {
+          int err = errno;
+          ::close(fd);
+          throw std::system_error(err, std::generic_category(), "pattern_database: write");
+        }
+        if (res > 0)
+          written += res;
+      }
+    };
+    write_all(&head, sizeof(head));
+    write_all(words_, word_count * sizeof(uint64_t));
+
+    if (::close(fd) != 0)
+      throw std::system_error(errno, std::generic_category(), "pattern_database: close");
+  }
+
+ private:
+
+  std::unique_ptr<packed_depth_array<Bits>> built_;
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  uint64_t rank_count_;
+  const uint64_t *words_;
+
+};
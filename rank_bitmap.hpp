@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Bitmap with one bit per rank of a rankable state
+ * space, used as a set of states when most ranks
+ * are reachable.
+ *
+ * set() and test() may be called concurrently,
+ * using relaxed atomic operations on the words.
+ * The words can also be accessed directly through
+ * data() by bulk passes that own a range of them.
+ */
+class rank_bitmap {
+ public:
+
+  /**
+   * Constructs a bitmap with every bit cleared.
+   *
+   * @param bit_count the number of ranks
+   */
+  explicit rank_bitmap(uint64_t bit_count) :
+    bit_count_(bit_count),
+    words_((bit_count + 63) / 64) {}
+
+  uint64_t bit_count() const {
+    return bit_count_;
+  }
+
+  std::size_t word_count() const {
+    return words_.size();
+  }
+
+  uint64_t *data() {
+    return words_.data();
+  }
+
+  const uint64_t *data() const {
+    return words_.data();
+  }
+
+  /**
+   * Thread safe.
+   *
+   * @param rank the bit to look at
+   * @return     whether the bit is set
+   */
+  bool test(uint64_t rank) const {
+    return __atomic_load_n(&words_[rank / 64], __ATOMIC_RELAXED) >> rank % 64 & 1;
+  }
+
+  /**
+   * Set a bit with an atomic or.
+   *
+   * Thread safe.
+   *
+   * @param rank the bit to set
+   * @return     whether the bit was not set before
+   */
+  bool set(uint64_t rank) {
+    uint64_t bit = uint64_t(1) << rank % 64;
+    return !(__atomic_fetch_or(&words_[rank / 64], bit, __ATOMIC_RELAXED) & bit);
+  }
+
+  /**
+   * Count the set bits of some words.
+   *
+   * @param begin_word the first word to count
+   * @param end_word   the word past the last word to count
+   * @return           the number of set bits
+   */
+  uint64_t count(std::size_t begin_word, std::size_t end_word) const {
+    uint64_t res = 0;
+    for (std::size_t i = begin_word; i < end_word; ++i)
+      res += __builtin_popcountll(words_[i]);
+    return res;
+  }
+
+  /**
+   * Clear every bit.
+   *
+   * Not thread safe.
+   */
+  void clear() {
+    std::fill(words_.begin(), words_.end(), 0);
+  }
+
+  /**
+   * Call f with the rank of every set bit in some
+   * words, skipping a whole word at a time when
+   * it is zero.
+   *
+   * @param begin_word the first word to scan
+   * @param end_word   the word past the last word to scan
+   * @param f          the function to call with every rank
+   */
+  template<class F>
+  void for_each(std::size_t begin_word, std::size_t end_word, F &&f) const {
+    for (std::size_t i = begin_word; i < end_word; ++i)
+      for (uint64_t word = words_[i]; word; word &= word - 1)
+        f(uint64_t(i) * 64 + __builtin_ctzll(word));
+  }
+
+ private:
+
+  uint64_t bit_count_;
+  std::vector<uint64_t> words_;
+
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "chunked_vector.hpp"
+
+/**
+ * Reorder a layer in parallel so that its states are
+ * sorted by key, with chunk i holding the i-th key range.
+ *
+ * Each thread scatters its part of the layer into one
+ * bucket per key range, found from a sample of the keys,
+ * then each thread gathers and sorts one key range.
+ *
+ * @param layer        the layer to reorder, must not be written to meanwhile
+ * @param thread_count the number of threads to use, at most the number of chunks
+ * @param key          function mapping a state to an integer to sort by
+ */
+template<class T, class Allocator, class Key>
+void reorder_layer(chunked_vector<T, Allocator> &layer, int thread_count, Key &&key) {
+  constexpr size_t samples_per_thread = 64;
+
+  size_t total = layer.size();
+  if (total == 0)
+    return;
+
+  auto ranges = layer.split(thread_count);
+
+  std::vector<uint64_t> sample;
+  size_t sample_cnt = std::min(total, samples_per_thread * thread_count);
+  auto it = layer.begin();
+  for (size_t i = 0; i < sample_cnt; ++i)
+    sample.push_back(key(it[total * i / sample_cnt]));
+  std::sort(sample.begin(), sample.end());
+
+  std::vector<uint64_t> splitters;
+  for (int i = 1; i < thread_count; ++i)
+    splitters.push_back(sample[sample.size() * i / thread_count]);
+
+  // buckets[from][to] holds the states thread
+  // from found for the key range of thread to
+  using keyed = std::pair<uint64_t, T>;
+  std::vector<std::vector<std::vector<keyed>>> buckets(
+      thread_count, std::vector<std::vector<keyed>>(thread_count));
+
+  auto scatter = [&](int thread_id) {
+    for (auto [begin, end] = ranges[thread_id]; begin != end; ++begin) {
+      uint64_t state_key = key(*begin);
+      size_t to = std::upper_bound(splitters.begin(), splitters.end(), state_key)
+                - splitters.begin();
+      buckets[thread_id][to].emplace_back(state_key, std::move(*begin));
+    }
+  };
+
+  auto gather = [&](int thread_id) {
+    std::vector<keyed> range;
+    for (int from = 0; from < thread_count; ++from) {
+      auto &bucket = buckets[from][thread_id];
+      std::move(bucket.begin(), bucket.end(), std::back_inserter(range));
+      std::vector<keyed>().swap(bucket);
+    }
+    std::sort(range.begin(), range.end(), [](const keyed &l, const keyed &r) {
+      return l.first < r.first;
+    });
+    auto &chunk = layer.chunk(thread_id);
+    for (auto &[state_key, state] : range)
+      chunk.push_back(std::move(state));
+  };
+
+  std::vector<std::thread> threads(thread_count);
+
+  for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+    threads[thread_id] = std::thread(scatter, thread_id);
+  for (auto &thread : threads) thread.join();
+
+  layer.clear();
+
+  for (int thread_id = 0; thread_id < thread_count; ++thread_id)
+    threads[thread_id] = std::thread(gather, thread_id);
+  for (auto &thread : threads) thread.join();
+}
+
+/**
+ * Layer callback for bfs reordering every layer of
+ * at least min_size states with reorder_layer.
+ *
+ * @tparam Key function mapping a state to an integer to sort by
+ */
+template<class Key>
+struct layer_reorderer {
+  int thread_count;
+  Key key;
+  size_t min_size;
+
+  template<class Layer>
+  void operator()(Layer &layer, size_t) const {
+    if (layer.size() >= min_size)
+      reorder_layer(layer, thread_count, key);
+  }
+};
+
+template<class Key>
+layer_reorderer<Key> make_layer_reorderer(int thread_count, Key key, size_t min_size) {
+  return {thread_count, std::move(key), min_size};
+}
+
+/**
+ * Wraps a phmap parallel set to give it an emplace_batch
+ * that looks the states of a batch up in the order of
+ * the slots they hash to, instead of the order they
+ * were generated in.
+ *
+ * A counting sort scatters the batch into a bucket per
+ * submap and per 1<<order_bits equal ranges of its slots,
+ * so that a batch that is large next to the set sweeps
+ * every submap from front to back rather than missing
+ * the cache and the TLB on nearly every lookup. States
+ * must be default constructible.
+ *
+ * The slot ranges are taken from the capacity of the set
+ * when prepare is called, which must be done while no
+ * thread inserts, as it reads every submap unlocked. The
+ * bfs_batched callers do so before every layer.
+ *
+ * @tparam Set the phmap parallel set type
+ */
+template<class Set>
+class slot_ordered_set {
+ public:
+
+  explicit slot_ordered_set(Set &set, int order_bits = 8) :
+    set_(set), order_bits_(order_bits) {
+    prepare();
+  }
+
+  /**
+   * Size the slot ranges to the current capacity of the
+   * set. Submaps grow on their own, so this is their
+   * slot count only on average, and it goes stale as
+   * they grow until the next call.
+   */
+  void prepare() {
+    slot_bits_ = 0;
+    while (set_.capacity() / Set::subcnt() >> slot_bits_) ++slot_bits_;
+  }
+
+  template<class K>
+  auto emplace(K &&key) {
+    return set_.emplace(std::forward<K>(key));
+  }
+
+  /**
+   * Insert the states of [first, last), writing those
+   * that were not in the set to inserted, in slot order.
+   * May be called by several threads at once, but not
+   * together with prepare.
+   */
+  template<class InputIt, class OutputIt>
+  OutputIt emplace_batch(InputIt first, InputIt last, OutputIt inserted) {
+    using T = typename std::iterator_traits<InputIt>::value_type;
+    using hashed = std::pair<size_t, T>;
+
+    size_t slot_mask = (size_t(1) << slot_bits_) - 1;
+    int shift = std::max(0, slot_bits_ - order_bits_);
+
+    auto bucket = [&](size_t hash) {
+      return Set::subidx(hash) << order_bits_ | ((hash >> 7) & slot_mask) >> shift;
+    };
+
+    std::vector<hashed> batch;
+    std::vector<size_t> offsets((Set::subcnt() << order_bits_) + 1);
+    for (; first != last; ++first) {
+      size_t hash = set_.hash(*first);
+      ++offsets[bucket(hash) + 1];
+      batch.emplace_back(hash, std::move(*first));
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<hashed> ordered(batch.size());
+    for (auto &entry : batch)
+      ordered[offsets[bucket(entry.first)]++] = std::move(entry);
+    std::vector<hashed>().swap(batch);
+
+    for (auto &[hash, state] : ordered)
+      if (set_.emplace_with_hash(hash, state).second)
+        *inserted++ = std::move(state);
+    return inserted;
+  }
+
+ private:
+
+  Set &set_;
+  int order_bits_;
+  int slot_bits_;
+
+};
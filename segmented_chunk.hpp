@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Vector-like container that grows by appending
+ * fixed-size segments instead of reallocating,
+ * so push_back never moves existing elements.
+ *
+ * Segments are carved out of slabs, which start at
+ * one segment and double up to a full slab, so small
+ * chunks stay small. clear() keeps every segment for
+ * reuse, so each chunk acts as a pool for the thread
+ * writing it.
+ * The header is aligned to a cache line so that
+ * chunks of different threads never false-share.
+ *
+ * @tparam T         the type to store
+ * @tparam Allocator the allocator used for the slabs
+ */
+template<class T, class Allocator = std::allocator<T>>
+class alignas(64) segmented_chunk {
+
+  template<class DerefType, class ChunkRefType>
+  class iterator_base;
+
+ public:
+
+  using value_type = T;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = iterator_base<T&, segmented_chunk*>;
+  using const_iterator = iterator_base<const T&, const segmented_chunk*>;
+
+  /**
+   * Number of elements in a segment, a power of two
+   * chosen so a segment is roughly 64KiB.
+   */
+  static constexpr size_t segment_size = [] {
+    size_t size = 1;
+    while (size * 2 * sizeof(T) <= (size_t(1) << 16))
+      size *= 2;
+    return size;
+  }();
+
+  /**
+   * Bytes of a full slab, the segment size rounded up
+   * to a multiple of 2MB whatever sizeof(T) is, so
+   * huge_page_allocator backs full slabs with huge pages.
+   */
+  static constexpr size_t slab_bytes = [] {
+    constexpr size_t huge_page_size = size_t(2) << 20;
+    return (segment_size * sizeof(T) + huge_page_size - 1) / huge_page_size * huge_page_size;
+  }();
+
+  /**
+   * Number of segments carved out of a full slab,
+   * leaving less than a segment of it unused.
+   */
+  static constexpr size_t segments_per_slab = slab_bytes / (segment_size * sizeof(T));
+
+  /**
+   * Constructs an empty chunk.
+   *
+   * @param alloc the allocator to get slabs from
+   */
+  explicit segmented_chunk(const Allocator &alloc = Allocator()) :
+    alloc_(alloc),
+    size_(0) {}
+
+  segmented_chunk(const segmented_chunk&) = delete;
+  segmented_chunk &operator=(const segmented_chunk&) = delete;
+
+  segmented_chunk(segmented_chunk &&other) noexcept :
+    alloc_(std::move(other.alloc_)),
+    size_(std::exchange(other.size_, 0)),
+    segments_(std::move(other.segments_)),
+    slabs_(std::move(other.slabs_)) {}
+
+  segmented_chunk &operator=(segmented_chunk &&other) noexcept {
+    if (this != &other) {
+      release();
+      alloc_ = std::move(other.alloc_);
+      size_ = std::exchange(other.size_, 0);
+      segments_ = std::move(other.segments_);
+      slabs_ = std::move(other.slabs_);
+    }
+    return *this;
+  }
+
+  ~segmented_chunk() {
+    release();
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /**
+   * @return how many elements fit in the
+   *         segments already allocated
+   */
+  size_t capacity() const {
+    return segments_.size() * segment_size;
+  }
+
+  void push_back(const T &value) {
+    emplace_back(value);
+  }
+
+  void push_back(T &&value) {
+    emplace_back(std::move(value));
+  }
+
+  template<class... Args>
+  T &emplace_back(Args&&... args) {
+    if (size_ == capacity())
+      grow();
+    T *slot = &segments_[size_ / segment_size][size_ % segment_size];
+    std::allocator_traits<Allocator>::construct(alloc_, slot, std::forward<Args>(args)...);
+    ++size_;
+    return *slot;
+  }
+
+  T &operator[](size_t index) {
+    return segments_[index / segment_size][index % segment_size];
+  }
+
+  const T &operator[](size_t index) const {
+    return segments_[index / segment_size][index % segment_size];
+  }
+
+  T &back() {
+    return (*this)[size_ - 1];
+  }
+
+  /**
+   * Remove the elements in [first, last),
+   * moving the later elements forward.
+   *
+   * @return an iterator to where first pointed
+   */
+  iterator erase(iterator first, iterator last) {
+    iterator new_end = std::move(last, end(), first);
+    shrink(new_end - begin());
+    return first;
+  }
+
+  /**
+   * Remove all elements, keeping the
+   * segments for the next elements.
+   */
+  void clear() {
+    shrink(0);
+  }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size_); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+ private:
+
+  using traits = std::allocator_traits<Allocator>;
+
+  // slabs are allocated in units of the alignment
+  // of T, so their size in bytes can be exact
+  struct alignas(T) slab_unit {
+    unsigned char bytes[alignof(T)];
+  };
+  using slab_allocator = typename traits::template rebind_alloc<slab_unit>;
+  using slab_traits = std::allocator_traits<slab_allocator>;
+
+  Allocator alloc_;
+  size_t size_;
+  std::vector<T*> segments_;
+  std::vector<T*> slabs_;
+
+  /**
+   * Number of segments of the slab with an index,
+   * doubling from 1 until it is a full slab.
+   */
+  static size_t slab_segments(size_t slab_index) {
+    size_t segments = 1;
+    for (size_t i = 0; i < slab_index && segments < segments_per_slab; ++i)
+      segments *= 2;
+    return std::min(segments, segments_per_slab);
+  }
+
+  /**
+   * Number of slab_units of the slab with an index,
+   * only rounded up to slab_bytes for a full slab.
+   */
+  static size_t slab_units(size_t slab_index) {
+    size_t segments = slab_segments(slab_index);
+    size_t bytes = segments == segments_per_slab ? slab_bytes
+                                                 : segments * segment_size * sizeof(T);
+    return bytes / sizeof(slab_unit);
+  }
+
+  void grow() {
+    slab_allocator slab_alloc(alloc_);
+    size_t slab_index = slabs_.size();
+    T *slab = reinterpret_cast<T*>(
+        slab_traits::allocate(slab_alloc, slab_units(slab_index)));
+    slabs_.push_back(slab);
+    for (size_t i = 0; i < slab_segments(slab_index); ++i)
+      segments_.push_back(slab + i * segment_size);
+  }
+
+  void shrink(size_t new_size) {
+    if (!std::is_trivially_destructible<T>::value)
+      for (size_t i = new_size; i < size_; ++i)
+        traits::destroy(alloc_, &(*this)[i]);
+    size_ = new_size;
+  }
+
+  void release() {
+    shrink(0);
+    slab_allocator slab_alloc(alloc_);
+    for (size_t i = 0; i < slabs_.size(); ++i)
+      slab_traits::deallocate(slab_alloc, reinterpret_cast<slab_unit*>(slabs_[i]),
+                              slab_units(i));
+    slabs_.clear();
+    segments_.clear();
+  }
+
+};
+
+/**
+ * Random access iterator over a segmented_chunk.
+ *
+ * @tparam DerefType    the type the iterator yields
+ * @tparam ChunkRefType the type of the pointer to the iterated chunk
+ */
+template<class T, class Allocator>
+template<class DerefType, class ChunkRefType>
+class segmented_chunk<T, Allocator>::iterator_base {
+  friend class segmented_chunk;
+
+  iterator_base(ChunkRefType chunk_ref, size_t index) :
+    chunk_ref_(chunk_ref),
+    index_(index) {}
+
+ public:
+
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = T;
+  using difference_type = ptrdiff_t;
+  using pointer = std::remove_reference_t<DerefType>*;
+  using reference = DerefType;
+
+  iterator_base() :
+    chunk_ref_(nullptr),
+    index_(0) {}
+
+  DerefType operator*() const { return (*chunk_ref_)[index_]; }
+  pointer operator->() const { return &**this; }
+  DerefType operator[](ptrdiff_t offset) const { return (*chunk_ref_)[index_ + offset]; }
+
+  iterator_base &operator+=(ptrdiff_t offset) { index_ += offset; return *this; }
+  iterator_base &operator-=(ptrdiff_t offset) { index_ -= offset; return *this; }
+  iterator_base &operator++() { ++index_; return *this; }
+  iterator_base &operator--() { --index_; return *this; }
+  iterator_base operator++(int) { iterator_base cpy = *this; ++index_; return cpy; }
+  iterator_base operator--(int) { iterator_base cpy = *this; --index_; return cpy; }
+
+  iterator_base operator+(ptrdiff_t offset) const { return {chunk_ref_, index_ + offset}; }
+  iterator_base operator-(ptrdiff_t offset) const { return {chunk_ref_, index_ - offset}; }
+  friend iterator_base operator+(ptrdiff_t offset, const iterator_base &it) { return it + offset; }
+  ptrdiff_t operator-(const iterator_base &o) const { return index_ - o.index_; }
+
+  friend bool operator==(const iterator_base &l, const iterator_base &r) { return l.index_ == r.index_; }
+  friend bool operator!=(const iterator_base &l, const iterator_base &r) { return l.index_ != r.index_; }
+  friend bool operator< (const iterator_base &l, const iterator_base &r) { return l.index_ <  r.index_; }
+  friend bool operator<=(const iterator_base &l, const iterator_base &r) { return l.index_ <= r.index_; }
+  friend bool operator>=(const iterator_base &l, const iterator_base &r) { return l.index_ >= r.index_; }
+  friend bool operator> (const iterator_base &l, const iterator_base &r) { return l.index_ >  r.index_; }
+
+ private:
+
+  ChunkRefType chunk_ref_;
+  size_t index_;
+
+};
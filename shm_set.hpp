@@ -0,0 +1,362 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "splitmix64.hpp"
+
+/**
+ * Hash set for use by multiple threads
+ * in multiple processes at once.
+ *
+ * The table lives in a POSIX shared-memory segment,
+ * and is addressed only by offsets from the start of
+ * the segment, so each process may map it anywhere.
+ * Slots are claimed with atomic compare-and-swap
+ * on a per-slot state word instead of locking, so
+ * inserting never needs any IPC.
+ *
+ * While a slot is written its state word holds the
+ * pid of the writer. A process waiting on a slot
+ * whose writer has died resets it to empty, so a
+ * worker crashing mid-insert blocks no one else.
+ * This needs every process to share a pid namespace.
+ *
+ * The first process to open a name creates and sizes
+ * the segment, the others attach to it and use the
+ * same number of buckets and post-hash seed. Attaching
+ * gives up after attach_timeout if the segment is never
+ * set up, like when its creator died, and the name must
+ * then be removed with unlink() before it is used. Hash
+ * must give the same value for equal keys in every
+ * process, which rules out hashing pointers.
+ *
+ * @tparam Key      The type to store in the set, must be trivially copyable
+ * @tparam Hash     Function-object type for hasing keys
+ * @tparam KeyEqual Function-object type for checking key equality
+ */
+template<
+ class Key,
+ class Hash = std::hash<Key>,
+ class KeyEqual = std::equal_to<Key>
+> class shm_set {
+  static_assert(std::is_trivially_copyable<Key>::value,
+                "shm_set stores keys as raw bytes in shared memory");
+  static_assert(std::atomic<uint32_t>::is_always_lock_free
+             && std::atomic<uint64_t>::is_always_lock_free,
+                "shm_set needs address-free atomics to share them between processes");
+
+ public:
+
+  /**
+   * Creates the shared set, or attaches to it
+   * if another process already created it.
+   *
+   * Throws std::runtime_error if attaching waits longer
+   * than attach_timeout for the creator to set it up.
+   *
+   * @param name      Name of the shared-memory segment, like "/bfs_vis"
+   * @param bits      Number of slots will be 1<<bits, ignored when attaching
+   * @param seed      Used in post-hash to make adversarial
+   *                  input hard to create, ignored when attaching
+   * @param hash      Instance to use of the Hash function-object type
+   * @param key_equal Instance to use of the KeyEqual function-object type
+   */
+  shm_set(
+      const std::string &name,
+      int bits,
+      uint64_t seed = std::chrono::steady_clock::now().time_since_epoch().count(),
+      const Hash &hash = Hash(),
+      const KeyEqual &key_equal = KeyEqual()) :
+    hash_(hash),
+    key_equal_(key_equal) {
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool creator = fd >= 0;
+    if (!creator && errno == EEXIST)
+      fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), "shm_set: shm_open " + name);
+
+    auto deadline = std::chrono::steady_clock::now() + attach_timeout;
+    auto abandoned = [&]() {
+      return std::runtime_error("shm_set: " + name + " was never set up by its creator");
+    };
+
+    if (creator) {
+      segment_size_ = segment_size(bits);
+      if (::ftruncate(fd, segment_size_) != 0) {
+        int err = errno;
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::system_error(err, std::generic_category(), "shm_set: ftruncate");
+      }
+    } else {
+      // wait for the creator to size the segment
+      struct stat st;
+      for (;;) {
+        if (::fstat(fd, &st) != 0) {
+          int err = errno;
+          ::close(fd);
+          throw std::system_error(err, std::generic_category(), "shm_set: fstat");
+        }
+        if (st.st_size != 0)
+          break;
+        if (std::chrono::steady_clock::now() > deadline) {
+          ::close(fd);
+          throw abandoned();
+        }
+        std::this_thread::yield();
+      }
+      segment_size_ = st.st_size;
+    }
+
+    void *mapping = ::mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+      throw std::system_error(err, std::generic_category(), "shm_set: mmap");
+    base_ = static_cast<unsigned char*>(mapping);
+
+    if (creator) {
+      // the segment starts zeroed, which is
+      // every slot being empty and a size of 0
+      header()->bits = bits;
+      header()->seed = seed;
+      header()->states_offset = states_offset();
+      header()->keys_offset = keys_offset(bits);
+      header()->magic.store(magic, std::memory_order_release);
+    } else {
+      while (header()->magic.load(std::memory_order_acquire) != magic) {
+        if (std::chrono::steady_clock::now() > deadline) {
+          ::munmap(base_, segment_size_);
+          throw abandoned();
+        }
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  shm_set(const shm_set&) = delete;
+  shm_set &operator=(const shm_set&) = delete;
+
+  /**
+   * Unmaps the segment, which stays alive
+   * until it is removed with unlink().
+   */
+  ~shm_set() {
+    ::munmap(base_, segment_size_);
+  }
+
+  /**
+   * Removes the name of a segment so that the memory
+   * is freed once every process has unmapped it.
+   *
+   * @param name the name the set was constructed with
+   */
+  static void unlink(const std::string &name) {
+    ::shm_unlink(name.c_str());
+  }
+
+  /**
+   * @brief holds a member
+   * boolean with the name
+   * second to allow drop in
+   * replacement for std::set
+   */
+  struct second_holder {
+    bool second;
+    operator bool() {
+      return second;
+    }
+  };
+
+  /**
+   * Insert a key in a set if it is not there,
+   * and return whether it was already there.
+   *
+   * @param  key The key to insert
+   * @return true if the element was inserted,
+   *         and false if it was already there.
+   */
+  second_holder emplace(const Key &key) {
+    const size_t mask = (size_t(1) << header()->bits) - 1;
+    size_t index = splitmix64(hash_(key) + header()->seed) & mask;
+
+    for (size_t probed = 0; probed <= mask;) {
+      std::atomic<uint32_t> &state = states()[index];
+      uint32_t current = state.load(std::memory_order_acquire);
+
+      if (current == empty
+          && state.compare_exchange_strong(current, writing + own_pid(),
+                                           std::memory_order_acquire)) {
+        std::memcpy(keys() + index * sizeof(Key), &key, sizeof(Key));
+        state.store(full, std::memory_order_release);
+        header()->size.fetch_add(1, std::memory_order_relaxed);
+        return {true};
+      }
+
+      // another thread or process is writing this
+      // slot, and it might be writing the same key
+      if (wait_for_writer(state, current) == empty)
+        continue;
+
+      Key in_slot;
+      std::memcpy(&in_slot, keys() + index * sizeof(Key), sizeof(Key));
+      if (key_equal_(in_slot, key))
+        return {false};
+
+      index = (index + 1) & mask;
+      ++probed;
+    }
+
+    throw std::length_error("shm_set: all slots are full");
+  }
+
+  /**
+   * Find the number of elements.
+   *
+   * @return the number of keys inserted so far
+   *         by all processes together
+   */
+  size_t size() const {
+    return header()->size.load(std::memory_order_relaxed);
+  }
+
+ private:
+
+  static constexpr uint64_t magic = 0x7465735f6d6873;  // "shm_set"
+
+  // states from writing on are writing + the pid of the writer
+  enum : uint32_t { empty = 0, full = 1, writing = 2 };
+
+  // how long attaching waits for the creator
+  // to size the segment and write the header
+  static constexpr std::chrono::seconds attach_timeout{10};
+
+  // how many times to yield to a writer between
+  // checks of whether its process is still alive
+  static constexpr unsigned liveness_interval = 1 << 10;
+
+  /**
+   * @brief the start of the segment, holding what
+   * attaching processes need to agree on the layout
+   */
+  struct segment_header {
+    std::atomic<uint64_t> magic;
+    std::atomic<uint64_t> size;
+    uint64_t bits;
+    uint64_t seed;
+    uint64_t states_offset;
+    uint64_t keys_offset;
+  };
+
+  Hash hash_;
+  KeyEqual key_equal_;
+
+  size_t segment_size_;
+  unsigned char *base_;
+
+  /**
+   * Wait until a slot is no longer being written, and
+   * return its state then. If the writing process dies
+   * first, the slot is reset to empty, as it was before
+   * the writer claimed it.
+   */
+  static uint32_t wait_for_writer(std::atomic<uint32_t> &state, uint32_t current) {
+    for (unsigned yields = 1; current >= writing; ++yields) {
+      if (yields % liveness_interval == 0 && !process_alive(current - writing)) {
+        // on failure current is reloaded, and someone
+        // else has reclaimed or published the slot
+        if (state.compare_exchange_strong(current, empty, std::memory_order_acquire))
+          return empty;
+        continue;
+      }
+      std::this_thread::yield();
+      current = state.load(std::memory_order_acquire);
+    }
+    return current;
+  }
+
+  /**
+   * The pid of this process, cached as it is needed
+   * for every insertion, and renewed in fork children.
+   */
+  static uint32_t own_pid() {
+    static std::atomic<uint32_t> pid = [] {
+      ::pthread_atfork(nullptr, nullptr, +[] { pid.store(::getpid(), std::memory_order_relaxed); });
+      return uint32_t(::getpid());
+    }();
+    return pid.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Whether a process may still finish a write, which
+   * it may not when it is a zombie, exited but not yet
+   * reaped, like a crashed worker its parent waits on.
+   */
+  static bool process_alive(uint32_t pid) {
+    if (::kill(pid_t(pid), 0) != 0)
+      return errno != ESRCH;
+
+    std::string path = "/proc/" + std::to_string(pid) + "/stat";
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return true;
+    char stat[512];
+    ssize_t len = ::read(fd, stat, sizeof(stat) - 1);
+    ::close(fd);
+    if (len <= 0)
+      return true;
+    stat[len] = 0;
+
+    // the state follows the command name in parentheses
+    const char *name_end = std::strrchr(stat, ')');
+    return !name_end || name_end[1] != ' ' || (name_end[2] != 'Z' && name_end[2] != 'X');
+  }
+
+  static size_t align_up(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+
+  static size_t states_offset() {
+    return align_up(sizeof(segment_header), alignof(std::atomic<uint32_t>));
+  }
+
+  static size_t keys_offset(int bits) {
+    return align_up(states_offset() + (size_t(1) << bits) * sizeof(std::atomic<uint32_t>),
+                    alignof(Key));
+  }
+
+  static size_t segment_size(int bits) {
+    return keys_offset(bits) + (size_t(1) << bits) * sizeof(Key);
+  }
+
+  segment_header *header() const {
+    return reinterpret_cast<segment_header*>(base_);
+  }
+
+  std::atomic<uint32_t> *states() const {
+    return reinterpret_cast<std::atomic<uint32_t>*>(base_ + header()->states_offset);
+  }
+
+  unsigned char *keys() const {
+    return base_ + header()->keys_offset;
+  }
+
+};
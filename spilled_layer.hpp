@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "codec.hpp"
+
+/**
+ * Compressor that stores blocks as they are.
+ *
+ * Compressors for spilled_layer transform a whole
+ * block of encoded states before it is written,
+ * and transform it back after it is read.
+ */
+struct identity_compressor {
+  std::vector<char> compress(std::vector<char> raw) const {
+    return raw;
+  }
+
+  std::vector<char> decompress(std::vector<char> stored) const {
+    return stored;
+  }
+};
+
+/**
+ * A pool of background threads running
+ * file I/O for spilled layers.
+ */
+class async_io {
+ public:
+
+  /**
+   * Starts the I/O threads.
+   *
+   * @param thread_count the number of I/O requests
+   *                     that can be running at once
+   */
+  explicit async_io(int thread_count = 1) {
+    for (int i = 0; i < thread_count; ++i)
+      threads_.emplace_back([this]() { run(); });
+  }
+
+  async_io(const async_io&) = delete;
+  async_io &operator=(const async_io&) = delete;
+
+  /**
+   * Finishes the queued requests and stops the threads.
+   */
+  ~async_io() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &thread : threads_)
+      thread.join();
+  }
+
+  /**
+   * Queue a function to run on an I/O thread.
+   *
+   * @param  job the function to run
+   * @return a future for the result of job,
+   *         or the exception it threw
+   */
+  template<class F>
+  auto submit(F &&job) -> std::future<decltype(job())> {
+    using result = decltype(job());
+    auto task = std::make_shared<std::packaged_task<result()>>(std::forward<F>(job));
+    auto future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.emplace_back([task]() { (*task)(); });
+    }
+    wake_.notify_one();
+    return future;
+  }
+
+ private:
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> jobs_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+
+  void run() {
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&]() { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty())
+          return;
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+      }
+      job();
+    }
+  }
+
+};
+
+/**
+ * Data structure that behaves like a chunked_vector
+ * whose chunks are stored in files instead of RAM.
+ *
+ * Each chunk can be written to by a single thread,
+ * which fills a block in memory and hands it to the
+ * I/O threads once it is sealed, so writing overlaps
+ * with producing the next states. Reading a chunk back
+ * streams its blocks with a number of reads kept in flight.
+ *
+ * The files are unlinked as soon as they are created,
+ * so they disappear when the layer is destroyed.
+ *
+ * @tparam T          the type to store
+ * @tparam Codec      how states are turned into bytes
+ * @tparam Compressor how blocks of bytes are stored
+ */
+template<class T, class Codec = trivial_codec<T>, class Compressor = identity_compressor>
+class spilled_layer {
+
+  struct block_info {
+    off_t offset;
+    size_t stored_size;
+    size_t count;
+  };
+
+  struct chunk_file {
+    int fd = -1;
+    std::vector<block_info> blocks;
+  };
+
+ public:
+
+  class writer;
+  class reader;
+
+  /**
+   * Constructs the layer and creates its files.
+   *
+   * @param io            the threads to run the file I/O on
+   * @param path_prefix   where to create the files, like "/nvme/layer"
+   * @param chunk_cnt     the number of chunks to create
+   * @param codec         how to encode the states
+   * @param compressor    how to compress the blocks
+   * @param block_bytes   how many encoded bytes to collect before writing
+   * @param max_in_flight how many blocks a chunk may have queued for writing
+   */
+  spilled_layer(
+      async_io &io,
+      const std::string &path_prefix,
+      size_t chunk_cnt,
+      const Codec &codec = Codec(),
+      const Compressor &compressor = Compressor(),
+      size_t block_bytes = size_t(1) << 20,
+      size_t max_in_flight = 4) :
+    io_(io),
+    codec_(codec),
+    compressor_(compressor),
+    block_bytes_(block_bytes),
+    max_in_flight_(max_in_flight),
+    files_(chunk_cnt) {
+    for (size_t i = 0; i < chunk_cnt; ++i) {
+      std::string path = path_prefix + "_" + std::to_string(i) + "_XXXXXX";
+      files_[i].fd = ::mkstemp(&path[0]);
+      if (files_[i].fd < 0) {
+        int err = errno;
+        close_files();
+        throw std::system_error(err, std::generic_category(), "spilled_layer: mkstemp " + path);
+      }
+      ::unlink(path.c_str());
+    }
+    for (size_t i = 0; i < chunk_cnt; ++i)
+      writers_.emplace_back(new writer(*this, files_[i]));
+  }
+
+  spilled_layer(const spilled_layer&) = delete;
+  spilled_layer &operator=(const spilled_layer&) = delete;
+
+  ~spilled_layer() {
+    // writes still in flight refer to the files
+    for (auto &chunk_writer : writers_)
+      chunk_writer->wait();
+    close_files();
+  }
+
+  /**
+   * Access a chunk for writing.
+   *
+   * Writing to the chunk is thread safe
+   * as long as any single chunk_index
+   * is used by at most 1 thread.
+   *
+   * @param chunk_index the index of the chunk to access
+   * @return            a reference to the writer of the chunk
+   */
+  writer &chunk(size_t chunk_index) {
+    return *writers_[chunk_index];
+  }
+
+  /**
+   * Write out the last partial block of every chunk,
+   * and wait until everything is on disk.
+   *
+   * Not thread safe.
+   */
+  void seal() {
+    for (auto &chunk_writer : writers_)
+      chunk_writer->flush();
+  }
+
+  /**
+   * Find the number of elements.
+   *
+   * @return the number of elements in all sealed blocks
+   */
+  size_t size() const {
+    size_t res = 0;
+    for (const auto &file : files_)
+      for (const auto &block : file.blocks)
+        res += block.count;
+    return res;
+  }
+
+  /**
+   * @return the number of chunks
+   */
+  size_t chunk_count() const {
+    return files_.size();
+  }
+
+  /**
+   * Stream a sealed chunk back.
+   *
+   * @param chunk_index the index of the chunk to read
+   * @param read_ahead  how many blocks to keep reads in flight for
+   * @return            a reader yielding the states of the chunk in order
+   */
+  reader read_chunk(size_t chunk_index, size_t read_ahead = 4) const {
+    return reader(*this, files_[chunk_index], read_ahead);
+  }
+
+ private:
+
+  async_io &io_;
+  Codec codec_;
+  Compressor compressor_;
+  const size_t block_bytes_;
+  const size_t max_in_flight_;
+  std::vector<chunk_file> files_;
+  std::vector<std::unique_ptr<writer>> writers_;
+
+  void close_files() {
+    for (auto &file : files_)
+      if (file.fd >= 0)
+        ::close(file.fd);
+  }
+
+};
+
+/**
+ * Writes the states of a single chunk.
+ */
+template<class T, class Codec, class Compressor>
+class spilled_layer<T, Codec, Compressor>::writer {
+  friend class spilled_layer;
+
+  writer(spilled_layer &layer, chunk_file &file) :
+    layer_(layer),
+    file_(file),
+    offset_(0),
+    count_(0) {}
+
+ public:
+
+  void push_back(const T &value) {
+    layer_.codec_.encode(value, buffer_);
+    ++count_;
+    if (buffer_.size() >= layer_.block_bytes_)
+      seal_block();
+  }
+
+  /**
+   * Write the partial block and wait
+   * until all blocks are written.
+   */
+  void flush() {
+    if (count_)
+      seal_block();
+    wait();
+  }
+
+ private:
+
+  spilled_layer &layer_;
+  chunk_file &file_;
+  off_t offset_;
+  size_t count_;
+  std::vector<char> buffer_;
+  std::deque<std::future<void>> in_flight_;
+
+  void wait() {
+    while (!in_flight_.empty()) {
+      in_flight_.front().get();
+      in_flight_.pop_front();
+    }
+  }
+
+  void seal_block() {
+    auto stored = std::make_shared<std::vector<char>>(
+        layer_.compressor_.compress(std::move(buffer_)));
+    buffer_ = std::vector<char>();
+    buffer_.reserve(layer_.block_bytes_ + layer_.block_bytes_ / 8);
+
+    file_.blocks.push_back({offset_, stored->size(), count_});
+    off_t offset = offset_;
+    offset_ += stored->size();
+    count_ = 0;
+
+    int fd = file_.fd;
+    in_flight_.push_back(layer_.io_.submit([fd, offset, stored]() {
+      size_t written = 0;
+      while (written < stored->size()) {
+        ssize_t res = ::pwrite(fd, stored->data() + written,
+                               stored->size() - written, offset + written);
+        if (res < 0 && errno != EINTR)
+          throw std::system_error(errno, std::generic_category(), "spilled_layer: pwrite");
+        if (res > 0)
+          written += res;
+      }
+    }));
+
+    // wait for the oldest write instead of
+    // buffering a whole layer in memory
+    if (in_flight_.size() > layer_.max_in_flight_) {
+      in_flight_.front().get();
+      in_flight_.pop_front();
+    }
+  }
+
+};
+
+/**
+ * Streams the states of a single sealed chunk.
+ */
+template<class T, class Codec, class Compressor>
+class spilled_layer<T, Codec, Compressor>::reader {
+  friend class spilled_layer;
+
+  reader(const spilled_layer &layer, const chunk_file &file, size_t read_ahead) :
+    layer_(layer),
+    file_(file),
+    read_ahead_(read_ahead ? read_ahead : 1),
+    next_block_(0),
+    position_(nullptr),
+    remaining_(0) {
+    while (in_flight_.size() < read_ahead_ && next_block_ < file_.blocks.size())
+      request_block();
+  }
+
+ public:
+
+  /**
+   * Read the next state.
+   *
+   * @param  value where to store the state
+   * @return false if the chunk is exhausted
+   */
+  bool next(T &value) {
+    while (remaining_ == 0) {
+      if (in_flight_.empty())
+        return false;
+      block_ = layer_.compressor_.decompress(in_flight_.front().get());
+      remaining_ = file_.blocks[next_block_ - in_flight_.size()].count;
+      in_flight_.pop_front();
+      position_ = block_.data();
+      if (next_block_ < file_.blocks.size())
+        request_block();
+    }
+    position_ = layer_.codec_.decode(position_, value);
+    --remaining_;
+    return true;
+  }
+
+ private:
+
+  const spilled_layer &layer_;
+  const chunk_file &file_;
+  const size_t read_ahead_;
+  size_t next_block_;
+  std::deque<std::future<std::vector<char>>> in_flight_;
+  std::vector<char> block_;
+  const char *position_;
+  size_t remaining_;
+
+  void request_block() {
+    block_info info = file_.blocks[next_block_++];
+    int fd = file_.fd;
+    in_flight_.push_back(layer_.io_.submit([fd, info]() {
+      std::vector<char> stored(info.stored_size);
+      size_t read = 0;
+      while (read < stored.size()) {
+        ssize_t res = ::pread(fd, stored.data() + read, stored.size() - read,
+                              info.offset + read);
+        if (res < 0 && errno != EINTR)
+          throw std::system_error(errno, std::generic_category(), "spilled_layer: pread");
+        if (res == 0)
+          throw std::runtime_error("spilled_layer: unexpected end of file");
+        if (res > 0)
+          read += res;
+      }
+      return stored;
+    }));
+  }
+
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Post-hash used to to mitigate
+ * issues from a bad distribution of a hash
+ * function when it is truncated to its low bits
+ *
+ * @param x hash value with a possibly bad distribution when truncated
+ * @return  a new hash with all bits hopefully well distributed
+ */
+inline uint64_t splitmix64(uint64_t x) {
+  // http://xorshift.di.unimi.it/splitmix64.c
+  x += 0x9e3779b97f4a7c15;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
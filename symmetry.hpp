@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+/**
+ * Counts kept by a symmetry-reduced search.
+ *
+ * canonical_neighbors counts successors into a shard
+ * of its thread, on a cache line of its own, so that
+ * threads do not contend, and the shards are summed
+ * when read. The search counts what it stores.
+ */
+struct symmetry_stats {
+  static constexpr std::size_t shard_count = 64;
+
+  struct alignas(64) shard {
+    std::atomic<uint64_t> successors{0};
+    std::atomic<uint64_t> replaced{0};
+  };
+
+  std::array<shard, shard_count> shards;
+
+  /**
+   * Representatives stored by the search.
+   */
+  std::atomic<uint64_t> representatives{0};
+
+  /**
+   * The sum of the orbit sizes of the stored
+   * representatives, which is the number of states
+   * they stand for, or 0 if no orbit size was given.
+   */
+  std::atomic<uint64_t> represented{0};
+
+  /**
+   * The shard of the calling thread. Threads take
+   * the shards in turn, so up to shard_count threads
+   * started together get one each.
+   */
+  shard &own_shard() {
+    static std::atomic<std::size_t> next_shard{0};
+    static thread_local std::size_t index = next_shard++ % shard_count;
+    return shards[index];
+  }
+
+  /**
+   * Successors generated before canonicalization.
+   */
+  uint64_t successors() const {
+    uint64_t res = 0;
+    for (const auto &s : shards) res += s.successors.load(std::memory_order_relaxed);
+    return res;
+  }
+
+  /**
+   * Successors that were not their own representative
+   * and were replaced by it. Many of them may be the
+   * same state, so this does not tell how much smaller
+   * the search got, which represented does.
+   */
+  uint64_t replaced() const {
+    uint64_t res = 0;
+    for (const auto &s : shards) res += s.replaced.load(std::memory_order_relaxed);
+    return res;
+  }
+};
+
+/**
+ * Neighbors function replacing every successor by the
+ * canonical representative of its symmetry class, so
+ * that any engine stores, deduplicates and expands
+ * only representatives.
+ *
+ * canonicalize must map every state of a class to
+ * the same state of the class, and the transitions
+ * must commute with the symmetries, so that the
+ * successors of a representative represent the
+ * successors of every state in its class.
+ *
+ * @tparam Neighbors    the wrapped neighbors function, returning a container
+ * @tparam Canonicalize function mapping a state to its representative
+ * @tparam KeyEqual     function-object type for checking state equality
+ */
+template<class Neighbors, class Canonicalize, class KeyEqual = std::equal_to<>>
+class canonical_neighbors {
+ public:
+
+  canonical_neighbors(Neighbors neighbors, Canonicalize canonicalize,
+                      symmetry_stats &stats, KeyEqual key_equal = KeyEqual()) :
+    neighbors_(std::move(neighbors)),
+    canonicalize_(std::move(canonicalize)),
+    key_equal_(std::move(key_equal)),
+    stats_(stats) {}
+
+  template<class T>
+  auto operator()(const T &state) const {
+    auto transitions = neighbors_(state);
+    uint64_t successors = 0, replaced = 0;
+    for (auto &next : transitions) {
+      ++successors;
+      auto representative = canonicalize_(next);
+      if (!key_equal_(representative, next)) {
+        next = std::move(representative);
+        ++replaced;
+      }
+    }
+    auto &shard = stats_.own_shard();
+    shard.successors.fetch_add(successors, std::memory_order_relaxed);
+    shard.replaced.fetch_add(replaced, std::memory_order_relaxed);
+    return transitions;
+  }
+
+ private:
+
+  Neighbors neighbors_;
+  Canonicalize canonicalize_;
+  KeyEqual key_equal_;
+  symmetry_stats &stats_;
+
+};
+
+template<class Neighbors, class Canonicalize>
+canonical_neighbors<Neighbors, Canonicalize>
+make_canonical_neighbors(Neighbors neighbors, Canonicalize canonicalize,
+                         symmetry_stats &stats) {
+  return {std::move(neighbors), std::move(canonicalize), stats};
+}
+
+/**
+ * Orbit size function for when the sizes are not
+ * known, leaving symmetry_stats::represented at 0.
+ */
+struct no_orbit_size {};